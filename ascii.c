@@ -0,0 +1,473 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        ascii                                               *
+*                                                                           *
+*   Purpose:            Parse the YXZ and XYZ ASCII input formats straight  *
+*                       out of memory.  This replaces fgets into a 256 byte *
+*                       buffer followed by strchr and sscanf.  Lines can be *
+*                       any length and numbers are converted without any    *
+*                       locale lookups.                                     *
+*                                                                           *
+*                       Numbers with no more than 19 significant digits and *
+*                       a decimal exponent no bigger than 22 (that's pretty *
+*                       much every number in a sounding file) are exactly   *
+*                       representable as mantissa * 10^exp using one        *
+*                       floating point multiply or divide so we get the     *
+*                       same, correctly rounded, answer as strtod (see      *
+*                       Clinger, "How to Read Floating Point Numbers        *
+*                       Accurately", 1990).  Anything else is handed to     *
+*                       strtod.                                             *
+*                                                                           *
+\***************************************************************************/
+
+#include "ascii.h"
+#include "reader.h"
+
+
+
+/*  Exactly representable powers of ten.  */
+
+static const double powers_of_ten[23] =
+  {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+    1e20, 1e21, 1e22
+  };
+
+
+#define IS_DIGIT(c)     ((uint8_t) ((c) - '0') < 10)
+#define IS_BLANK(c)     ((c) == ' ' || (c) == '\t' || (c) == '\r')
+
+
+
+/*  Skip spaces and tabs.  */
+
+static const char *skip_blanks (const char *ptr, const char *end)
+{
+  while (ptr < end && IS_BLANK (*ptr)) ptr++;
+
+  return (ptr);
+}
+
+
+
+/*  Skip the separator between two fields (blanks and at most one comma).  */
+
+static const char *skip_separator (const char *ptr, const char *end)
+{
+  ptr = skip_blanks (ptr, end);
+
+  if (ptr < end && *ptr == ',') ptr = skip_blanks (ptr + 1, end);
+
+  return (ptr);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        ascii_next_line                                     *
+*                                                                           *
+*   Purpose:            Return a pointer to the start of the line following *
+*                       the one starting at line (or end).                  *
+*                                                                           *
+\***************************************************************************/
+
+const char *ascii_next_line (const char *line, const char *end)
+{
+  const char           *nl;
+
+
+  nl = (const char *) memchr (line, '\n', end - line);
+
+  if (nl == NULL) return (end);
+
+  return (nl + 1);
+}
+
+
+
+/*  Parse an integer of at most max_digits digits (like sscanf's %3d).  Returns NULL if there are no digits.  */
+
+static const char *parse_int (const char *ptr, const char *end, int32_t max_digits, int32_t *value)
+{
+  int32_t              sign = 1, n = 0, val = 0;
+
+
+  ptr = skip_blanks (ptr, end);
+
+  if (ptr < end && (*ptr == '-' || *ptr == '+'))
+    {
+      if (*ptr == '-') sign = -1;
+      ptr++;
+    }
+
+  while (ptr < end && n < max_digits && IS_DIGIT (*ptr))
+    {
+      val = val * 10 + (*ptr - '0');
+      ptr++;
+      n++;
+    }
+
+  if (!n) return (NULL);
+
+  *value = sign * val;
+
+  return (ptr);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        ascii_parse_double                                  *
+*                                                                           *
+*   Purpose:            Convert a number starting at ptr (after any         *
+*                       leading blanks).                                    *
+*                                                                           *
+*   Outputs:            const char *    -   pointer to the first character  *
+*                                           after the number or NULL if     *
+*                                           there wasn't a number           *
+*                                                                           *
+\***************************************************************************/
+
+const char *ascii_parse_double (const char *ptr, const char *end, double *value)
+{
+  const char           *start;
+  char                 token[64], *token_end;
+  uint64_t             mantissa = 0;
+  int32_t              digits = 0, exponent = 0, exp_val = 0, exp_sign = 1, i;
+  uint8_t              negative = NVFalse, seen_digit = NVFalse;
+  double               val;
+
+
+  ptr = skip_blanks (ptr, end);
+  start = ptr;
+
+  if (ptr < end && (*ptr == '-' || *ptr == '+'))
+    {
+      negative = (*ptr == '-');
+      ptr++;
+    }
+
+
+  /*  Integer part.  Leading zeros don't count as significant digits.  */
+
+  for ( ; ptr < end && IS_DIGIT (*ptr) ; ptr++)
+    {
+      seen_digit = NVTrue;
+
+      if (mantissa || *ptr != '0')
+        {
+          if (digits < 19)
+            {
+              mantissa = mantissa * 10 + (*ptr - '0');
+            }
+          else
+            {
+              exponent++;
+            }
+          digits++;
+        }
+    }
+
+
+  /*  Fraction.  */
+
+  if (ptr < end && *ptr == '.')
+    {
+      for (ptr++ ; ptr < end && IS_DIGIT (*ptr) ; ptr++)
+        {
+          seen_digit = NVTrue;
+
+          if (mantissa || *ptr != '0')
+            {
+              if (digits < 19)
+                {
+                  mantissa = mantissa * 10 + (*ptr - '0');
+                  exponent--;
+                }
+              digits++;
+            }
+          else
+            {
+              exponent--;
+            }
+        }
+    }
+
+  if (!seen_digit) goto slow;
+
+
+  /*  Exponent.  */
+
+  if (ptr < end && (*ptr == 'e' || *ptr == 'E'))
+    {
+      const char *exp_ptr = ptr + 1;
+
+      if (exp_ptr < end && (*exp_ptr == '-' || *exp_ptr == '+'))
+        {
+          if (*exp_ptr == '-') exp_sign = -1;
+          exp_ptr++;
+        }
+
+      if (exp_ptr < end && IS_DIGIT (*exp_ptr))
+        {
+          for ( ; exp_ptr < end && IS_DIGIT (*exp_ptr) ; exp_ptr++)
+            {
+              if (exp_val < 10000) exp_val = exp_val * 10 + (*exp_ptr - '0');
+            }
+
+          exponent += exp_sign * exp_val;
+          ptr = exp_ptr;
+        }
+    }
+
+
+  /*  Clinger's fast path.  */
+
+  if (digits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+    {
+      val = (double) mantissa;
+
+      if (exponent < 0)
+        {
+          val /= powers_of_ten[-exponent];
+        }
+      else
+        {
+          val *= powers_of_ten[exponent];
+        }
+
+      *value = negative ? -val : val;
+
+      return (ptr);
+    }
+
+
+  /*  Everything else (too many digits, huge exponents, inf, nan, ...) goes to strtod.  */
+
+ slow:
+
+  for (i = 0 ; i < (int32_t) sizeof (token) - 1 && start + i < end && !IS_BLANK (start[i]) && start[i] != ',' &&
+         start[i] != '\n' ; i++) token[i] = start[i];
+  token[i] = 0;
+
+  val = strtod (token, &token_end);
+
+  if (token_end == token) return (NULL);
+
+  *value = val;
+
+  return (start + (token_end - token));
+}
+
+
+
+/*  Parse DDD-MM-SS.SSS followed by an optional hemisphere character.  */
+
+static const char *parse_dms (const char *ptr, const char *end, double *value)
+{
+  int32_t              deg, min;
+  double               sec;
+
+
+  if ((ptr = parse_int (ptr, end, 3, &deg)) == NULL || ptr >= end || *ptr != '-') return (NULL);
+  if ((ptr = parse_int (ptr + 1, end, 2, &min)) == NULL || ptr >= end || *ptr != '-') return (NULL);
+  if ((ptr = ascii_parse_double (ptr + 1, end, &sec)) == NULL) return (NULL);
+
+  *value = (double) deg + (double) min / 60.0 + sec / 3600.0;
+
+  if (ptr < end && (*ptr == 'S' || *ptr == 'W' || *ptr == 's' || *ptr == 'w'))
+    {
+      *value = -(*value);
+      ptr++;
+    }
+  else if (ptr < end && (*ptr == 'N' || *ptr == 'E' || *ptr == 'n' || *ptr == 'e'))
+    {
+      ptr++;
+    }
+
+  return (ptr);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        ascii_parse_line                                    *
+*                                                                           *
+*   Purpose:            Parse one line of a YXZ or XYZ file.                *
+*                                                                           *
+*   Inputs:             line        -   start of the line                   *
+*                       end         -   end of the line (the newline or the *
+*                                       end of the file)                    *
+*                       filetype    -   YXZ_FILE or XYZ_FILE                *
+*                       x, y, z     -   the point                           *
+*                                                                           *
+*   Outputs:            uint8_t     -   NVTrue if we got a point, NVFalse   *
+*                                       for comments and bad lines          *
+*                                                                           *
+*   YXZ_FILE:           Reads a Hypack yxz file in the following format:    *
+*                                                                           *
+*                           DDD-MM-SS.SSSs,DDD-MM-SS.SSSs,DD.DDD            *
+*                                                                           *
+*                       Example:                                            *
+*                                                                           *
+*                           013-27-18.771N,144-37-41.383E,53.230            *
+*                                                                           *
+*                       Or it will read files derived from Hypack RAW files *
+*                       that are in the following format:                   *
+*                                                                           *
+*   YEAR DAY HH:MM:SS.SSSS   DD.ddddddddd  DDD.ddddddddd   depth   depth   depth
+*   2001 017 03:25:10.0620   13.430910402  144.660955271    7.06    8.77    8.02
+*                                                                           *
+*                       Third depth is tide corrected.                      *
+*                                                                           *
+*                       Or it will read YXZ files in the following formats: *
+*                                                                           *
+*                           [signed] lat  [signed] lon  depth               *
+*                                                                           *
+*                       or                                                  *
+*                                                                           *
+*                           [signed] lat,[signed] lon,depth                 *
+*                                                                           *
+*                       Example:                                            *
+*                                                                           *
+*                           21.000278 -157.619722 223                       *
+*                                                                           *
+*                       or                                                  *
+*                                                                           *
+*                           21.000278,-157.619722,223                       *
+*                                                                           *
+*   XYZ_FILE:           Same as the last two YXZ formats except that the    *
+*                       longitude comes first.                              *
+*                                                                           *
+*                       Example:                                            *
+*                                                                           *
+*                           -157.619722 21.000278 223.5                     *
+*                                                                           *
+*                       or                                                  *
+*                                                                           *
+*                           -157.619722,21.000278,223.5                     *
+*                                                                           *
+*                       In all formats, lines that start with a # are       *
+*                       comments.                                           *
+*                                                                           *
+\***************************************************************************/
+
+uint8_t ascii_parse_line (const char *line, const char *end, int32_t filetype, double *x, double *y, double *z)
+{
+  const char           *ptr;
+  int32_t              year, day, hour, minute;
+  double               second, dep, a, b, c;
+
+
+  if (line >= end || *line == '#') return (NVFalse);
+
+
+  if (filetype == YXZ_FILE)
+    {
+      /*  Hypack RAW (the only format with a colon in it).  */
+
+      if (memchr (line, ':', end - line) != NULL)
+        {
+          if ((ptr = parse_int (line, end, 9, &year)) == NULL) return (NVFalse);
+          if ((ptr = parse_int (ptr, end, 9, &day)) == NULL) return (NVFalse);
+          if ((ptr = parse_int (ptr, end, 9, &hour)) == NULL || ptr >= end || *ptr != ':') return (NVFalse);
+          if ((ptr = parse_int (ptr + 1, end, 9, &minute)) == NULL || ptr >= end || *ptr != ':') return (NVFalse);
+          if ((ptr = ascii_parse_double (ptr + 1, end, &second)) == NULL) return (NVFalse);
+          if ((ptr = ascii_parse_double (ptr, end, y)) == NULL) return (NVFalse);
+          if ((ptr = ascii_parse_double (ptr, end, x)) == NULL) return (NVFalse);
+          if ((ptr = ascii_parse_double (ptr, end, &dep)) == NULL) return (NVFalse);
+          if ((ptr = ascii_parse_double (ptr, end, &dep)) == NULL) return (NVFalse);
+          if ((ptr = ascii_parse_double (ptr, end, z)) == NULL) return (NVFalse);
+
+          return (NVTrue);
+        }
+
+
+      /*  Old fixed column DDD-MM-SS.SSSs format.  Positions are in columns 1-13 and 16-28, depth starts in column 31,
+          and the hemisphere can be anywhere on the line.  This is exactly what the sscanf version did.  */
+
+      if (end - line > 31 && line[3] == '-' && line[7] == '-')
+        {
+          int32_t latdeg, latmin, londeg, lonmin;
+          double latsec, lonsec;
+
+          if ((ptr = parse_int (&line[1], &line[14], 3, &latdeg)) == NULL || ptr >= &line[14] || *ptr != '-') return (NVFalse);
+          if ((ptr = parse_int (ptr + 1, &line[14], 2, &latmin)) == NULL || ptr >= &line[14] || *ptr != '-') return (NVFalse);
+          if (ascii_parse_double (ptr + 1, &line[14], &latsec) == NULL) return (NVFalse);
+
+          if ((ptr = parse_int (&line[16], &line[29], 3, &londeg)) == NULL || ptr >= &line[29] || *ptr != '-') return (NVFalse);
+          if ((ptr = parse_int (ptr + 1, &line[29], 2, &lonmin)) == NULL || ptr >= &line[29] || *ptr != '-') return (NVFalse);
+          if (ascii_parse_double (ptr + 1, &line[29], &lonsec) == NULL) return (NVFalse);
+
+          if (ascii_parse_double (&line[31], end, z) == NULL) return (NVFalse);
+
+          *y = (double) latdeg + (double) latmin / 60.0 + latsec / 3600.0;
+          if (memchr (line, 'S', end - line)) *y = -(*y);
+          *x = (double) londeg + (double) lonmin / 60.0 + lonsec / 3600.0;
+          if (memchr (line, 'W', end - line)) *x = -(*x);
+
+          return (NVTrue);
+        }
+
+
+      /*  DDD-MM-SS.SSSs,DDD-MM-SS.SSSs,DD.DDD as documented above.  */
+
+      ptr = skip_blanks (line, end);
+
+      if (end - ptr > 7 && ptr[3] == '-' && ptr[6] == '-')
+        {
+          if ((ptr = parse_dms (ptr, end, y)) == NULL) return (NVFalse);
+          if ((ptr = parse_dms (skip_separator (ptr, end), end, x)) == NULL) return (NVFalse);
+          if (ascii_parse_double (skip_separator (ptr, end), end, z) == NULL) return (NVFalse);
+
+          return (NVTrue);
+        }
+    }
+
+
+  /*  Plain comma or blank separated decimal degrees.  */
+
+  if ((ptr = ascii_parse_double (line, end, &a)) == NULL) return (NVFalse);
+  if ((ptr = ascii_parse_double (skip_separator (ptr, end), end, &b)) == NULL) return (NVFalse);
+  if (ascii_parse_double (skip_separator (ptr, end), end, &c) == NULL) return (NVFalse);
+
+  if (filetype == YXZ_FILE)
+    {
+      *y = a;
+      *x = b;
+    }
+  else
+    {
+      *x = a;
+      *y = b;
+    }
+  *z = c;
+
+  return (NVTrue);
+}
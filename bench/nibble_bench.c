@@ -0,0 +1,230 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        nibble_bench                                        *
+*                                                                           *
+*   Purpose:            Check and time surface_nibble (see surface.c)       *
+*                       against the window scan that chrtr2 used to nibble  *
+*                       with, on a synthetic mask.  Each cell is real with  *
+*                       probability density.  Every cell's keep flag must   *
+*                       match the window scan, and every Z must come back   *
+*                       unchanged.  Only the scan is timed on the old side  *
+*                       (the old code also did a chrtr2 read and write for  *
+*                       every nibbled cell).                                *
+*                                                                           *
+*                       This isn't part of the chrtr2 build.  mk's qmake    *
+*                       -project picks up every .c file under the source    *
+*                       directory, so the program is only compiled with     *
+*                       NIBBLE_BENCH defined.  Build it from this directory *
+*                       with:                                               *
+*                                                                           *
+*                         gcc -O2 -DNVLinux -DNIBBLE_BENCH -I..             *
+*                             -I$PFM_ABE_DEV/include nibble_bench.c         *
+*                             ../surface.c -o nibble_bench                  *
+*                                                                           *
+*                       and run it as:                                      *
+*                                                                           *
+*                         nibble_bench COLS ROWS NIBBLE DENSITY [NO_SCAN]   *
+*                                                                           *
+*                       e.g. nibble_bench 20000 20000 5 0.01.  A non-zero   *
+*                       NO_SCAN skips the window scan (and the check) for   *
+*                       grids where it would take too long.                 *
+*                                                                           *
+\***************************************************************************/
+
+#ifdef NIBBLE_BENCH
+
+#include <time.h>
+
+#include "surface.h"
+
+
+static double now ()
+{
+  struct timespec      ts;
+
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec + ts.tv_nsec * 1.0e-9);
+}
+
+
+
+int32_t main (int32_t argc, char **argv)
+{
+  SURFACE              *surface;
+  uint8_t              **val_array, **keep_array = NULL, *flags, found;
+  float                *z;
+  int32_t              i, j, k, m, cols, rows, nibble, dn, up, bw, fw, no_scan = 0;
+  int64_t              new_keep = 0, old_keep = 0, mismatches = 0;
+  double               density, start, new_time, old_time = 0.0;
+
+
+  if (argc < 5)
+    {
+      fprintf (stderr, "\nUsage: %s COLS ROWS NIBBLE DENSITY [NO_SCAN]\n\n", argv[0]);
+      exit (-1);
+    }
+
+  cols = atoi (argv[1]);
+  rows = atoi (argv[2]);
+  nibble = atoi (argv[3]);
+  density = atof (argv[4]);
+  if (argc > 5) no_scan = atoi (argv[5]);
+
+
+  /*  Z is made from the row and column so we can tell if a cell comes back from the wrong place.  */
+
+  val_array = (uint8_t **) malloc (rows * sizeof (uint8_t *));
+  z = (float *) malloc (cols * sizeof (float));
+  flags = (uint8_t *) malloc (cols);
+
+  if (val_array == NULL || z == NULL || flags == NULL)
+    {
+      perror ("Allocating mask");
+      exit (-1);
+    }
+
+  surface = surface_create (cols, rows);
+
+  srand48 (1);
+
+  for (i = 0 ; i < rows ; i++)
+    {
+      val_array[i] = (uint8_t *) malloc (cols);
+      if (val_array[i] == NULL)
+        {
+          perror ("Allocating mask");
+          exit (-1);
+        }
+
+      for (j = 0 ; j < cols ; j++)
+        {
+          val_array[i][j] = (drand48 () < density);
+          z[j] = (float) (i + j);
+          flags[j] = val_array[i][j] ? SURFACE_REAL : 0;
+        }
+
+      surface_put_row (surface, i, z, flags);
+    }
+
+
+  start = now ();
+  surface_nibble (surface, nibble);
+  new_time = now () - start;
+
+
+  /*  The window scan the way main.c used to do it (less the chrtr2 I/O).  */
+
+  if (!no_scan)
+    {
+      keep_array = (uint8_t **) malloc (rows * sizeof (uint8_t *));
+      if (keep_array == NULL)
+        {
+          perror ("Allocating keep mask");
+          exit (-1);
+        }
+
+      for (i = 0 ; i < rows ; i++)
+        {
+          keep_array[i] = (uint8_t *) malloc (cols);
+          if (keep_array[i] == NULL)
+            {
+              perror ("Allocating keep mask");
+              exit (-1);
+            }
+        }
+
+      start = now ();
+
+      for (i = 0 ; i < rows ; i++)
+        {
+          dn = MAX (i - nibble, 0);
+          up = MIN (i + nibble, rows - 1);
+
+          for (j = 0 ; j < cols ; j++)
+            {
+              found = val_array[i][j];
+
+              if (!found)
+                {
+                  bw = MAX (j - nibble, 0);
+                  fw = MIN (j + nibble, cols - 1);
+
+                  for (k = dn ; k <= up ; k++)
+                    {
+                      for (m = bw ; m <= fw ; m++)
+                        {
+                          if (val_array[k][m])
+                            {
+                              found = NVTrue;
+                              break;
+                            }
+                        }
+                      if (found) break;
+                    }
+                }
+
+              keep_array[i][j] = found;
+              old_keep += found;
+            }
+        }
+
+      old_time = now () - start;
+    }
+
+
+  for (i = 0 ; i < rows ; i++)
+    {
+      surface_get_row (surface, i, z, flags);
+
+      for (j = 0 ; j < cols ; j++)
+        {
+          new_keep += ((flags[j] & SURFACE_KEEP) != 0);
+
+          if (z[j] != (float) (i + j) || (flags[j] & SURFACE_REAL) != val_array[i][j]) mismatches++;
+          if (!no_scan && ((flags[j] & SURFACE_KEEP) != 0) != keep_array[i][j]) mismatches++;
+        }
+
+      free (val_array[i]);
+      if (!no_scan) free (keep_array[i]);
+    }
+
+  fprintf (stdout, "%d x %d, nibble %d, density %g\n", cols, rows, nibble, density);
+  fprintf (stdout, "surface_nibble  %9.3f s  %lld cells kept\n", new_time, (long long) new_keep);
+  if (!no_scan) fprintf (stdout, "window scan     %9.3f s  %lld cells kept\n", old_time, (long long) old_keep);
+  fprintf (stdout, "%lld mismatches\n", (long long) mismatches);
+
+  surface_free (surface);
+  free (val_array);
+  free (keep_array);
+  free (z);
+  free (flags);
+
+  return (mismatches ? -1 : 0);
+}
+
+#endif
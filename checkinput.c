@@ -38,7 +38,9 @@
 *   Purpose:            Check the input file to determine if swapping       *
 *                       bytes is necessary.                                 *
 *                                                                           *
-*   Inputs:             Pointer to file                                     *
+*   Inputs:             records     - the mapped DPG records (lat, lon,     *
+*                                     depth floats)                         *
+*                       num_records - number of records in the file         *
 *                                                                           *
 *   Outputs:            None                                                *
 *                                                                           *
@@ -51,7 +53,7 @@
 *   Routines Called:    None                                                *
 *                                                                           *
 *   Glossary:           depth       - Depth value measured in fathoms.      *
-*                       dpgptr      - Pointer to the DPG file.              *
+*                       records     - The mapped DPG records.               *
 *                       latitude    - Latitude position measured in         *
 *                                     decimal minutes.                      *
 *                       longitude   - Longitude position measured in        *
@@ -61,7 +63,7 @@
 *                                     needs to be called and returns        *
 *                                     0 (don't swap) or 1 (swap)            *
 *                                                                           *
-*   Method:             Read each individual value from a file.             *
+*   Method:             Look at each individual value in the file.          *
 *                       This method was necessary because dpg files         *
 *                       have no headers and the first record in the file    *
 *                       will not necessarily determine if the bytes need    *
@@ -73,12 +75,16 @@
 *                                                                           *
 *                       Jan Depner, 02/01/07                                *
 *                       Using NAVO standard data types.                     *
+*                                                                           *
+*                       PFM Software, 10/16/26                              *
+*                       Works on the memory mapped records instead of       *
+*                       doing three freads per record.                      *
 *                                                                           *                           
 \***************************************************************************/
 
 #include "nvutility.h"
 
-uint8_t checkinput (FILE *dpgptr)
+uint8_t checkinput (const float *records, int64_t num_records)
 {
   /* Variable declaration.   */
 
@@ -94,11 +100,13 @@ uint8_t checkinput (FILE *dpgptr)
     {
       /* Input the latitude, longitude, and depth of the CHRTR file.   */
 
-      status = fread (&latitude, sizeof (float), 1, dpgptr);
-      status = fread (&longitude, sizeof (float), 1, dpgptr);
-      status = fread (&depth, sizeof (float), 1, dpgptr);
-      latitude /= 60.0;
-      longitude /= 60.0;
+      status = (n < num_records);
+
+      if (!status) break;
+
+      latitude = records[n * 3] / 60.0;
+      longitude = records[n * 3 + 1] / 60.0;
+      depth = records[n * 3 + 2];
 
 
       /*  if latitude, longitude, or depth is too small or too large 
@@ -119,11 +127,10 @@ uint8_t checkinput (FILE *dpgptr)
       /* Check for zero in the latitude, longitude, and depth which indicates
          an end of file.                                                      */
     
-      if (((latitude == 0.0) && (longitude == 0.0) && (depth == 0.0)) || (status <= 0)) status = EOF;
+      if ((latitude == 0.0) && (longitude == 0.0) && (depth == 0.0)) status = EOF;
 
       n++;
     }
 
-  rewind (dpgptr);
   return (swap);
 }
@@ -1,6 +1,6 @@
 INCLUDEPATH += /c/PFM_ABEv7.0.0_Win64/include
-LIBS += -L /c/PFM_ABEv7.0.0_Win64/lib -lchrtr2 -lgsf -lCHARTS -lllz -lmisp -lpfm -lnvutility -lgdal -lxml2 -lpoppler -lm -liconv -lwsock32
-DEFINES += NVWIN3X
+LIBS += -L /c/PFM_ABEv7.0.0_Win64/lib -lchrtr2 -lgsf -lCHARTS -lllz -lmisp -lpfm -lnvutility -lgdal -lxml2 -lpoppler -lz -lzstd -llzma -lpthread -lm -liconv -lwsock32
+DEFINES += NVWIN3X _FILE_OFFSET_BITS=64
 CONFIG += console
 CONFIG -= qt
 QMAKE_LFLAGS += 
@@ -14,5 +14,5 @@ DEPENDPATH += .
 INCLUDEPATH += .
 
 # Input
-HEADERS += version.h
-SOURCES += checkinput.c main.c reader.c
+HEADERS += ascii.h decompress.h geolocate.h ingest.h las.h mapfile.h morton.h pointfile.h prebin.h reader.h spill.h summary.h surface.h version.h
+SOURCES += ascii.c checkinput.c decompress.c geolocate.c ingest.c las.c main.c mapfile.c morton.c pointfile.c prebin.c reader.c spill.c summary.c surface.c
@@ -0,0 +1,614 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        decompress                                          *
+*                                                                           *
+*   Purpose:            Read gzip (.gz), Zstandard (.zst), and xz (.xz)     *
+*                       compressed input files without decompressing them   *
+*                       to disk first.  Each open stream has a thread that  *
+*                       reads the compressed file and decompresses it into  *
+*                       a small ring of chunks while the reader parses the  *
+*                       chunks it already has.  Concatenated gzip members,  *
+*                       zstd frames, and xz streams are all handled (e.g.   *
+*                       files made with pigz, zstd -T0, or cat).            *
+*                                                                           *
+*                       Standard input and named pipes (see decompress.h)   *
+*                       go through the same thread, compressed or not, so   *
+*                       the reader never has to seek or know the size.      *
+*                                                                           *
+\***************************************************************************/
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#ifdef NVWIN3X
+#include <io.h>
+#endif
+
+#include <zlib.h>
+#include <zstd.h>
+#include <lzma.h>
+
+#include "decompress.h"
+
+
+/*  Size of the compressed input reads.  */
+
+#define INPUT_SIZE      (1024 * 1024)
+
+
+struct DECOMPRESS_STREAM
+{
+  int32_t              fd;
+  int32_t              type;
+  int64_t              file_size;
+  uint8_t              pipe;                /*  Not a regular file, data may trickle in  */
+  atomic_llong         in_pos;              /*  Compressed bytes read so far  */
+  uint8_t              *input;
+  int64_t              input_len;
+  int64_t              input_pos;
+  uint8_t              input_eof;
+
+
+  /*  Decoder state (only the one for our type is used).  */
+
+  z_stream             gzip;
+  uint8_t              gzip_member_done;    /*  Finished a gzip member, another may follow  */
+  ZSTD_DStream         *zstd;
+  uint8_t              zstd_frame_done;     /*  The last zstd call that did anything finished a frame  */
+  lzma_stream          xz;
+  uint8_t              decoder_ready;
+
+
+  /*  Chunk ring.  The thread fills the slot after the last full one, the reader empties the first full one.  */
+
+  pthread_t            thread;
+  pthread_mutex_t      mutex;
+  pthread_cond_t       cond;
+  uint8_t              *chunks[DECOMPRESS_DEPTH];
+  int64_t              lengths[DECOMPRESS_DEPTH];
+  int32_t              head;
+  int32_t              count;
+  int64_t              read_pos;            /*  Position in the head chunk  */
+  uint8_t              done;
+  uint8_t              error;
+  uint8_t              quit;
+};
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        decompress_type                                     *
+*                                                                           *
+*   Purpose:            Get the compression type from the file name.        *
+*                                                                           *
+\***************************************************************************/
+
+int32_t decompress_type (char *file)
+{
+  int32_t              len = strlen (file);
+
+
+  if (len > 3 && !strcmp (&file[len - 3], ".gz")) return (DECOMPRESS_GZIP);
+  if (len > 4 && !strcmp (&file[len - 4], ".zst")) return (DECOMPRESS_ZSTD);
+  if (len > 3 && !strcmp (&file[len - 3], ".xz")) return (DECOMPRESS_XZ);
+
+  return (DECOMPRESS_NONE);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        decompress_is_pipe                                  *
+*                                                                           *
+*   Purpose:            Check for the standard input and named pipe names.  *
+*                                                                           *
+\***************************************************************************/
+
+uint8_t decompress_is_pipe (char *file)
+{
+  if (!strcmp (file, DECOMPRESS_STDIN)) return (NVTrue);
+  if (!strncmp (file, DECOMPRESS_FIFO, strlen (DECOMPRESS_FIFO))) return (NVTrue);
+
+  return (NVFalse);
+}
+
+
+
+/*  Make sure there's some compressed input.  */
+
+static void fill_input (DECOMPRESS_STREAM *stream)
+{
+  if (stream->input_pos < stream->input_len || stream->input_eof) return;
+
+  do
+    {
+      stream->input_len = read (stream->fd, stream->input, INPUT_SIZE);
+    } while (stream->input_len < 0 && errno == EINTR);
+
+  stream->input_pos = 0;
+
+  if (stream->input_len <= 0)
+    {
+      stream->input_len = 0;
+      stream->input_eof = NVTrue;
+    }
+
+  atomic_fetch_add_explicit (&stream->in_pos, stream->input_len, memory_order_relaxed);
+}
+
+
+
+/*  Decompress into out until it's full or we run out of data.  Returns 0 if there's more to come, 1 at the end of
+    the data, and -1 on error.  */
+
+static int32_t fill_chunk (DECOMPRESS_STREAM *stream, uint8_t *out, int64_t size, int64_t *len)
+{
+  ZSTD_inBuffer        zin;
+  ZSTD_outBuffer       zout;
+  size_t               ret;
+  int32_t              status;
+
+
+  *len = 0;
+
+
+  /*  Uncompressed pipe data goes out as soon as we get it so a slow writer doesn't hold up the points it has sent.  */
+
+  if (stream->type == DECOMPRESS_NONE)
+    {
+      do
+        {
+          *len = read (stream->fd, out, size);
+        } while (*len < 0 && errno == EINTR);
+
+      if (*len < 0)
+        {
+          *len = 0;
+          return (-1);
+        }
+
+      if (!*len) return (1);
+
+      atomic_fetch_add_explicit (&stream->in_pos, *len, memory_order_relaxed);
+
+      return (0);
+    }
+
+
+  while (*len < size)
+    {
+      /*  Same for compressed pipe data, whatever we've decompressed goes out before we wait for more input.  */
+
+      if (stream->pipe && *len && stream->input_pos >= stream->input_len && !stream->input_eof) return (0);
+
+      fill_input (stream);
+
+      switch (stream->type)
+        {
+        case DECOMPRESS_GZIP:
+
+          /*  Another member may follow.  This is checked here instead of when the member ends so that a pipe hands
+              out the end of one member before we wait for the next.  */
+
+          if (stream->gzip_member_done)
+            {
+              if (stream->input_eof) return (1);
+              inflateReset (&stream->gzip);
+              stream->gzip_member_done = NVFalse;
+            }
+
+          stream->gzip.next_in = stream->input + stream->input_pos;
+          stream->gzip.avail_in = stream->input_len - stream->input_pos;
+          stream->gzip.next_out = out + *len;
+          stream->gzip.avail_out = size - *len;
+
+          status = inflate (&stream->gzip, Z_NO_FLUSH);
+
+          stream->input_pos = stream->input_len - stream->gzip.avail_in;
+          *len = size - stream->gzip.avail_out;
+
+          if (status == Z_STREAM_END)
+            {
+              stream->gzip_member_done = NVTrue;
+            }
+          else if (status == Z_BUF_ERROR)
+            {
+              if (stream->input_eof) return (-1);
+            }
+          else if (status != Z_OK)
+            {
+              return (-1);
+            }
+          break;
+
+
+        case DECOMPRESS_ZSTD:
+          zin.src = stream->input;
+          zin.size = stream->input_len;
+          zin.pos = stream->input_pos;
+          zout.dst = out;
+          zout.size = size;
+          zout.pos = *len;
+
+          ret = ZSTD_decompressStream (stream->zstd, &zout, &zin);
+
+          if (ZSTD_isError (ret)) return (-1);
+
+
+          /*  Once the input is gone the decoder will keep asking for the next frame so we have to remember whether the
+              last one was finished.  */
+
+          if (zin.pos == (size_t) stream->input_pos && zout.pos == (size_t) *len)
+            {
+              if (stream->input_eof) return (stream->zstd_frame_done ? 1 : -1);
+            }
+          else
+            {
+              stream->zstd_frame_done = (ret == 0);
+            }
+
+          stream->input_pos = zin.pos;
+          *len = zout.pos;
+          break;
+
+
+        case DECOMPRESS_XZ:
+          stream->xz.next_in = stream->input + stream->input_pos;
+          stream->xz.avail_in = stream->input_len - stream->input_pos;
+          stream->xz.next_out = out + *len;
+          stream->xz.avail_out = size - *len;
+
+          status = lzma_code (&stream->xz, stream->input_eof ? LZMA_FINISH : LZMA_RUN);
+
+          stream->input_pos = stream->input_len - stream->xz.avail_in;
+          *len = size - stream->xz.avail_out;
+
+          if (status == LZMA_STREAM_END) return (1);
+          if (status != LZMA_OK) return (-1);
+          break;
+        }
+    }
+
+  return (0);
+}
+
+
+
+/*  Decompression thread.  */
+
+static void *decompressor (void *arg)
+{
+  DECOMPRESS_STREAM    *stream = (DECOMPRESS_STREAM *) arg;
+  int32_t              slot, status = 0;
+  int64_t              len;
+
+
+  while (!status)
+    {
+      pthread_mutex_lock (&stream->mutex);
+
+      while (stream->count == DECOMPRESS_DEPTH && !stream->quit) pthread_cond_wait (&stream->cond, &stream->mutex);
+
+      if (stream->quit)
+        {
+          pthread_mutex_unlock (&stream->mutex);
+          break;
+        }
+
+      slot = (stream->head + stream->count) % DECOMPRESS_DEPTH;
+
+      pthread_mutex_unlock (&stream->mutex);
+
+
+      status = fill_chunk (stream, stream->chunks[slot], DECOMPRESS_CHUNK, &len);
+
+
+      pthread_mutex_lock (&stream->mutex);
+
+      stream->lengths[slot] = len;
+      if (len) stream->count++;
+
+      if (status)
+        {
+          stream->done = NVTrue;
+          stream->error = (status < 0);
+        }
+
+      pthread_cond_broadcast (&stream->cond);
+      pthread_mutex_unlock (&stream->mutex);
+    }
+
+  return (NULL);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        decompress_open                                     *
+*                                                                           *
+*   Purpose:            Open a compressed file and start decompressing it.  *
+*                                                                           *
+*   Inputs:             file        -   file name (.gz, .zst, or .xz) or    *
+*                                       pipe name (see decompress.h)        *
+*                                                                           *
+*   Outputs:            DECOMPRESS_STREAM * - stream or NULL on failure     *
+*                                                                           *
+\***************************************************************************/
+
+DECOMPRESS_STREAM *decompress_open (char *file)
+{
+  DECOMPRESS_STREAM    *stream;
+  struct stat          st;
+  int32_t              i;
+
+
+  stream = (DECOMPRESS_STREAM *) calloc (1, sizeof (DECOMPRESS_STREAM));
+  if (stream == NULL)
+    {
+      perror ("Allocating decompression stream");
+      return (NULL);
+    }
+
+  stream->type = decompress_type (file);
+
+  /*  On Windows descriptors default to text mode, which would turn CR/LF pairs into LF and stop at the first 0x1A
+      byte in compressed or binary data.  */
+
+  if (!strcmp (file, DECOMPRESS_STDIN))
+    {
+      stream->fd = STDIN_FILENO;
+
+#ifdef NVWIN3X
+      _setmode (STDIN_FILENO, _O_BINARY);
+#endif
+    }
+  else
+    {
+      if (!strncmp (file, DECOMPRESS_FIFO, strlen (DECOMPRESS_FIFO))) file += strlen (DECOMPRESS_FIFO);
+
+#ifdef NVWIN3X
+      stream->fd = open (file, O_RDONLY | O_BINARY);
+#else
+      stream->fd = open (file, O_RDONLY);
+#endif
+
+      if (stream->fd < 0)
+        {
+          perror (file);
+          free (stream);
+          return (NULL);
+        }
+    }
+
+
+  /*  Pipes don't have a size so decompress_percent will just return 0 for them.  */
+
+  if (!fstat (stream->fd, &st) && S_ISREG (st.st_mode))
+    {
+      stream->file_size = st.st_size;
+    }
+  else
+    {
+      stream->pipe = NVTrue;
+    }
+  atomic_init (&stream->in_pos, 0);
+
+  stream->input = (uint8_t *) malloc (INPUT_SIZE);
+  if (stream->input == NULL)
+    {
+      perror ("Allocating decompression input buffer");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < DECOMPRESS_DEPTH ; i++)
+    {
+      stream->chunks[i] = (uint8_t *) malloc (DECOMPRESS_CHUNK);
+      if (stream->chunks[i] == NULL)
+        {
+          perror ("Allocating decompression chunks");
+          exit (-1);
+        }
+    }
+
+
+  switch (stream->type)
+    {
+    case DECOMPRESS_NONE:
+      stream->decoder_ready = NVTrue;
+      break;
+
+    case DECOMPRESS_GZIP:
+
+      /*  15 + 32 lets zlib figure out gzip or zlib headers.  */
+
+      if (inflateInit2 (&stream->gzip, 15 + 32) == Z_OK) stream->decoder_ready = NVTrue;
+      break;
+
+    case DECOMPRESS_ZSTD:
+      stream->zstd = ZSTD_createDStream ();
+      if (stream->zstd != NULL && !ZSTD_isError (ZSTD_initDStream (stream->zstd))) stream->decoder_ready = NVTrue;
+      break;
+
+    case DECOMPRESS_XZ:
+      stream->xz = (lzma_stream) LZMA_STREAM_INIT;
+      if (lzma_stream_decoder (&stream->xz, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK) stream->decoder_ready = NVTrue;
+      break;
+    }
+
+  if (!stream->decoder_ready)
+    {
+      fprintf (stderr, "\n\nUnable to start decompressing file %s\n", file);
+      fflush (stderr);
+      decompress_close (stream);
+      return (NULL);
+    }
+
+
+  pthread_mutex_init (&stream->mutex, NULL);
+  pthread_cond_init (&stream->cond, NULL);
+
+  if (pthread_create (&stream->thread, NULL, decompressor, stream))
+    {
+      perror ("Starting decompression thread");
+      exit (-1);
+    }
+
+  return (stream);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        decompress_read                                     *
+*                                                                           *
+*   Purpose:            Get the next size bytes (or as many as are left) of *
+*                       decompressed data.  Waits for the decompression     *
+*                       thread if it hasn't caught up.  For a pipe this     *
+*                       only waits until there's some data, like read(2),   *
+*                       so a slow writer doesn't hold up what it has sent.  *
+*                                                                           *
+*   Inputs:             stream      -   stream                              *
+*                       buffer      -   where to put the data               *
+*                       size        -   bytes wanted                        *
+*                                                                           *
+*   Outputs:            int64_t     -   bytes read, 0 at the end of the     *
+*                                       data, -1 if the data is corrupt     *
+*                                                                           *
+\***************************************************************************/
+
+int64_t decompress_read (DECOMPRESS_STREAM *stream, uint8_t *buffer, int64_t size)
+{
+  int64_t              n, total = 0;
+
+
+  pthread_mutex_lock (&stream->mutex);
+
+  while (total < size)
+    {
+      if (stream->pipe && total && !stream->count) break;
+
+      while (!stream->count && !stream->done) pthread_cond_wait (&stream->cond, &stream->mutex);
+
+      if (!stream->count) break;
+
+      n = MIN (size - total, stream->lengths[stream->head] - stream->read_pos);
+
+      memcpy (buffer + total, stream->chunks[stream->head] + stream->read_pos, n);
+      total += n;
+      stream->read_pos += n;
+
+      if (stream->read_pos == stream->lengths[stream->head])
+        {
+          stream->head = (stream->head + 1) % DECOMPRESS_DEPTH;
+          stream->count--;
+          stream->read_pos = 0;
+          pthread_cond_broadcast (&stream->cond);
+        }
+    }
+
+  if (!total && stream->error) total = -1;
+
+  pthread_mutex_unlock (&stream->mutex);
+
+  return (total);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        decompress_percent                                  *
+*                                                                           *
+*   Purpose:            Percentage of the compressed file read so far.      *
+*                                                                           *
+\***************************************************************************/
+
+int32_t decompress_percent (DECOMPRESS_STREAM *stream)
+{
+  if (stream->file_size <= 0) return (0);
+
+  return ((int32_t) (((double) atomic_load_explicit (&stream->in_pos, memory_order_relaxed) /
+                      (double) stream->file_size) * 100.0));
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        decompress_close                                    *
+*                                                                           *
+*   Purpose:            Stop the decompression thread and free everything.  *
+*                                                                           *
+\***************************************************************************/
+
+void decompress_close (DECOMPRESS_STREAM *stream)
+{
+  int32_t              i;
+
+
+  if (stream == NULL) return;
+
+  if (stream->decoder_ready)
+    {
+      pthread_mutex_lock (&stream->mutex);
+      stream->quit = NVTrue;
+      pthread_cond_broadcast (&stream->cond);
+      pthread_mutex_unlock (&stream->mutex);
+
+      pthread_join (stream->thread, NULL);
+
+      pthread_mutex_destroy (&stream->mutex);
+      pthread_cond_destroy (&stream->cond);
+    }
+
+  switch (stream->type)
+    {
+    case DECOMPRESS_GZIP:
+      if (stream->decoder_ready) inflateEnd (&stream->gzip);
+      break;
+
+    case DECOMPRESS_ZSTD:
+      if (stream->zstd != NULL) ZSTD_freeDStream (stream->zstd);
+      break;
+
+    case DECOMPRESS_XZ:
+      lzma_end (&stream->xz);
+      break;
+    }
+
+  for (i = 0 ; i < DECOMPRESS_DEPTH ; i++) free (stream->chunks[i]);
+  free (stream->input);
+  if (stream->fd != STDIN_FILENO) close (stream->fd);
+  free (stream);
+}
@@ -0,0 +1,74 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+
+#ifndef __CHRTR2_DECOMPRESS_H__
+#define __CHRTR2_DECOMPRESS_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+
+
+/*  Compression types (from the file name extension).  */
+
+#define         DECOMPRESS_NONE         0           /*  Copied as is (only used for pipes)  */
+#define         DECOMPRESS_GZIP         1           /*  .gz  */
+#define         DECOMPRESS_ZSTD         2           /*  .zst  */
+#define         DECOMPRESS_XZ           3           /*  .xz  */
+
+
+/*  Input file names that are really pipes.  "-" is standard input and "fifo:" followed by a path is a named pipe.  The
+    rest of the name (e.g. fifo:/tmp/soundings.xyz.gz) still determines the file and compression types.  */
+
+#define         DECOMPRESS_STDIN        "-"
+#define         DECOMPRESS_FIFO         "fifo:"
+
+
+/*  The background thread decompresses into DECOMPRESS_DEPTH chunks of DECOMPRESS_CHUNK bytes so it can stay that far
+    ahead of the reader.  */
+
+#define         DECOMPRESS_CHUNK        (4 * 1024 * 1024)
+#define         DECOMPRESS_DEPTH        4
+
+
+typedef struct DECOMPRESS_STREAM DECOMPRESS_STREAM;
+
+
+int32_t decompress_type (char *file);
+uint8_t decompress_is_pipe (char *file);
+DECOMPRESS_STREAM *decompress_open (char *file);
+int64_t decompress_read (DECOMPRESS_STREAM *stream, uint8_t *buffer, int64_t size);
+int32_t decompress_percent (DECOMPRESS_STREAM *stream);
+void decompress_close (DECOMPRESS_STREAM *stream);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
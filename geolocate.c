@@ -0,0 +1,225 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        geolocate                                           *
+*                                                                           *
+*   Purpose:            Compute the positions of all of the beams in a      *
+*                       swath ping at once.  The beams are offset from the  *
+*                       ping position across track (heading + 90) and then  *
+*                       along track (heading), the same two legs that we    *
+*                       have always used with newgp.                        *
+*                                                                           *
+*                       With "fast" set the two legs are replaced by a      *
+*                       second order expansion on the WGS-84 ellipsoid      *
+*                       about the ping position:                            *
+*                                                                           *
+*                         dlat = dn/M - (de1^2 + de2^2) tan(lat) / (2NM)    *
+*                                - dn^2 K / (2M^2)                          *
+*                         dlon = [de + (dn1 de1 + dn2 de2 + dn1 de2)        *
+*                                tan(lat) / N] / (N cos(lat))               *
+*                                                                           *
+*                       where dn1/de1 and dn2/de2 are the north/east        *
+*                       components of the two legs, dn and de are their     *
+*                       sums, M and N are the meridional and prime          *
+*                       vertical radii of curvature, and K = M'/M.  All of  *
+*                       the trig is done once per ping so the beam loop is  *
+*                       just multiplies and adds that the compiler can      *
+*                       vectorize.  The error is third order in the offset  *
+*                       (about s^3 tan(lat) / R^2), which is well under a   *
+*                       centimeter out to 5 km from nadir below 60 degrees  *
+*                       of latitude.  Every ping is checked by positioning  *
+*                       its outermost beam with newgp and if the two        *
+*                       differ by more than GEOLOCATE_TOLERANCE meters (or  *
+*                       the ping is above GEOLOCATE_MAX_LAT) the whole ping *
+*                       is positioned with newgp.                           *
+*                                                                           *
+\***************************************************************************/
+
+#include "geolocate.h"
+
+
+#define WGS84_A         6378137.0
+#define WGS84_E2        0.00669437999014
+#define DEG2RAD         (M_PI / 180.0)
+#define RAD2DEG         (180.0 / M_PI)
+
+
+void newgp (double, double, double, double, double *, double *);
+
+
+
+/*  Position one beam with two newgp legs (the original method).  */
+
+static void exact_beam (double lat, double lon, double heading, double across, double along, uint8_t have_across,
+                        uint8_t have_along, double *y, double *x)
+{
+  double               lat1, lon1;
+
+
+  lat1 = lat;
+  lon1 = lon;
+
+  if (have_across) newgp (lat, lon, heading + 90.0, across, &lat1, &lon1);
+
+  if (have_along)
+    {
+      newgp (lat1, lon1, heading, along, y, x);
+    }
+  else
+    {
+      *y = lat1;
+      *x = lon1;
+    }
+}
+
+
+
+/*  Tangent plane expansion for the whole ping.  Returns NVFalse if the outermost beam doesn't check against newgp.  */
+
+static uint8_t tangent_plane (double lat, double lon, double heading, const double *across, const double *along,
+                              int32_t count, double *y, double *x)
+{
+  double               phi, sin_phi, cos_phi, tan_phi, w, m, n, k, sin_h, cos_h, a, b, dn1, de1, dn2, de2, dn, de,
+                       dlat_dn, dlat_de2, dlat_dn2, dlon_de, dlon_cross, max_dist, dist, ey, ex;
+  int32_t              i, max_beam;
+
+
+  if (fabs (lat) > GEOLOCATE_MAX_LAT) return (NVFalse);
+
+  phi = lat * DEG2RAD;
+  sin_phi = sin (phi);
+  cos_phi = cos (phi);
+  tan_phi = sin_phi / cos_phi;
+
+  w = 1.0 - WGS84_E2 * sin_phi * sin_phi;
+  n = WGS84_A / sqrt (w);
+  m = n * (1.0 - WGS84_E2) / w;
+  k = 3.0 * WGS84_E2 * sin_phi * cos_phi / w;
+
+  sin_h = sin (heading * DEG2RAD);
+  cos_h = cos (heading * DEG2RAD);
+
+
+  /*  Per ping coefficients (results in degrees).  */
+
+  dlat_dn = RAD2DEG / m;
+  dlat_de2 = -RAD2DEG * tan_phi / (2.0 * n * m);
+  dlat_dn2 = -RAD2DEG * k / (2.0 * m * m);
+  dlon_de = RAD2DEG / (n * cos_phi);
+  dlon_cross = tan_phi / n;
+
+
+  for (i = 0 ; i < count ; i++)
+    {
+      a = across ? across[i] : 0.0;
+      b = along ? along[i] : 0.0;
+
+      dn1 = -a * sin_h;
+      de1 = a * cos_h;
+      dn2 = b * cos_h;
+      de2 = b * sin_h;
+      dn = dn1 + dn2;
+      de = de1 + de2;
+
+      y[i] = lat + dn * dlat_dn + (de1 * de1 + de2 * de2) * dlat_de2 + dn * dn * dlat_dn2;
+      x[i] = lon + (de + (dn1 * de1 + dn2 * de2 + dn1 * de2) * dlon_cross) * dlon_de;
+      x[i] = x[i] > 180.0 ? x[i] - 360.0 : (x[i] < -180.0 ? x[i] + 360.0 : x[i]);
+    }
+
+
+  /*  Check the beam that is farthest from nadir.  */
+
+  max_dist = -1.0;
+  max_beam = 0;
+  for (i = 0 ; i < count ; i++)
+    {
+      a = across ? across[i] : 0.0;
+      b = along ? along[i] : 0.0;
+      dist = a * a + b * b;
+      if (dist > max_dist)
+        {
+          max_dist = dist;
+          max_beam = i;
+        }
+    }
+
+  if (count)
+    {
+      exact_beam (lat, lon, heading, across ? across[max_beam] : 0.0, along ? along[max_beam] : 0.0, across != NULL,
+                  along != NULL, &ey, &ex);
+
+      dn = (y[max_beam] - ey) * DEG2RAD * m;
+      ex = x[max_beam] - ex;
+      if (ex > 180.0) ex -= 360.0;
+      if (ex < -180.0) ex += 360.0;
+      de = ex * DEG2RAD * n * cos_phi;
+
+      if (dn * dn + de * de > GEOLOCATE_TOLERANCE * GEOLOCATE_TOLERANCE) return (NVFalse);
+    }
+
+  return (NVTrue);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        geolocate_ping                                      *
+*                                                                           *
+*   Purpose:            Position all of the beams in a ping.                *
+*                                                                           *
+*   Inputs:             lat, lon    -   ping position (degrees)             *
+*                       heading     -   ping heading (degrees)              *
+*                       across      -   across track distances (meters) or  *
+*                                       NULL                                *
+*                       along       -   along track distances (meters) or   *
+*                                       NULL                                *
+*                       beam_flags  -   beam flags or NULL                  *
+*                       ignore_mask -   beams with any of these flags set   *
+*                                       aren't positioned by newgp          *
+*                       count       -   number of beams                     *
+*                       fast        -   try the tangent plane expansion     *
+*                       y, x        -   beam latitudes and longitudes       *
+*                                                                           *
+*   Outputs:            None                                                *
+*                                                                           *
+\***************************************************************************/
+
+void geolocate_ping (double lat, double lon, double heading, const double *across, const double *along,
+                     const uint8_t *beam_flags, uint8_t ignore_mask, int32_t count, uint8_t fast, double *y, double *x)
+{
+  int32_t              i;
+
+
+  if (fast && tangent_plane (lat, lon, heading, across, along, count, y, x)) return;
+
+  for (i = 0 ; i < count ; i++)
+    {
+      if (beam_flags != NULL && (beam_flags[i] & ignore_mask)) continue;
+
+      exact_beam (lat, lon, heading, across ? across[i] : 0.0, along ? along[i] : 0.0, across != NULL, along != NULL,
+                  &y[i], &x[i]);
+    }
+}
@@ -0,0 +1,56 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+
+#ifndef __CHRTR2_GEOLOCATE_H__
+#define __CHRTR2_GEOLOCATE_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+
+
+/*  Largest difference (in meters) allowed between the tangent plane position and the newgp position of the outermost
+    beam of a ping.  If the check fails the whole ping is positioned with newgp.  */
+
+#define         GEOLOCATE_TOLERANCE     0.01
+
+
+/*  The tangent plane isn't used poleward of this latitude (tan (lat) blows up the error terms).  */
+
+#define         GEOLOCATE_MAX_LAT       85.0
+
+
+void geolocate_ping (double lat, double lon, double heading, const double *across, const double *along,
+                     const uint8_t *beam_flags, uint8_t ignore_mask, int32_t count, uint8_t fast, double *y, double *x);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,856 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        ingest                                              *
+*                                                                           *
+*   Purpose:            Read all of the input files using a pool of         *
+*                       decoder threads.  Each decoder thread takes the     *
+*                       next unread file from the list, splits it into      *
+*                       ranges with reader_plan (leaving all but the first  *
+*                       range for the other threads to pick up), reads its  *
+*                       range with its own READER_CONTEXT, and pushes the   *
+*                       point blocks onto a bounded, lock free queue.  The  *
+*                       thread that called ingest pops the blocks off of    *
+*                       the queue and hands them to the load function, so   *
+*                       the loader (i.e. misp_load) only ever runs on one   *
+*                       thread.  Empty blocks are recycled through a second *
+*                       queue so the memory in use never exceeds            *
+*                       queue_depth blocks.  If params->thread_load is set  *
+*                       the decoder threads hand their blocks to it         *
+*                       directly instead (see prebin.c).                    *
+*                                                                           *
+*                       The queues are Dmitry Vyukov's bounded MPMC queue   *
+*                       (a ring of cells with sequence numbers).  Nobody    *
+*                       ever takes a lock to push or pop a block.           *
+*                                                                           *
+\***************************************************************************/
+
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef NVWIN3X
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "ingest.h"
+#include "summary.h"
+
+
+
+/*  Block queue cell.  */
+
+typedef struct
+{
+  atomic_size_t        sequence;
+  READER_BLOCK         *block;
+} QUEUE_CELL;
+
+
+/*  Bounded multi-producer/multi-consumer queue of block pointers.  The enqueue and dequeue positions are kept on
+    separate cache lines so producers and the consumer don't fight over them.  */
+
+typedef struct
+{
+  QUEUE_CELL           *cells;
+  size_t               mask;
+  char                 pad0[64];
+  atomic_size_t        enqueue_pos;
+  char                 pad1[64];
+  atomic_size_t        dequeue_pos;
+  char                 pad2[64];
+} BLOCK_QUEUE;
+
+
+/*  A piece of work for a decoder thread.  */
+
+typedef struct
+{
+  int32_t              file;                /*  Index into the file list  */
+  int32_t              part;                /*  Which range of the file this is  */
+  int32_t              parts;               /*  How many ranges the file was split into  */
+  READER_RANGE         range;
+} INGEST_TASK;
+
+
+/*  Everything shared between the decoder threads and the loader.  The task list is only touched once per range so a
+    plain mutex is fine for it.  */
+
+typedef struct
+{
+  INGEST_PARAMS        *params;
+  BLOCK_QUEUE          full;                /*  Blocks waiting to be loaded  */
+  BLOCK_QUEUE          empty;               /*  Blocks waiting to be filled  */
+  pthread_mutex_t      task_mutex;
+  INGEST_TASK          *pending;            /*  Ranges that have been split off but not read yet  */
+  int32_t              pending_head;
+  int32_t              pending_tail;
+  int32_t              pending_size;
+  int32_t              next_file;           /*  Index of the next file to be planned  */
+  int32_t              planning;            /*  Number of threads in reader_plan  */
+  atomic_int           num_tasks;           /*  Total number of tasks (files plus split off ranges)  */
+  atomic_int           active;              /*  Number of decoder threads still running  */
+  atomic_llong         percent_sum;         /*  Sum of the percent read for all tasks  */
+  atomic_llong         culled;              /*  GSF pings culled by the readers  */
+  atomic_llong         skipped;             /*  Files skipped by reader_plan or their summaries  */
+  FILE_SUMMARY         *summaries;          /*  Summaries being built (only if params->summaries is set)  */
+  pthread_mutex_t      *summary_mutex;      /*  One per file, held while a range's summary is merged into it  */
+  atomic_int           *parts_left;         /*  Ranges of each file whose summaries haven't been merged yet  */
+  void                 *user_data;          /*  For params->thread_load and params->thread_done  */
+  atomic_llong         points;              /*  Points read so far  */
+  pthread_cond_t       prefetch_cond;       /*  Signaled (under task_mutex) when next_file moves or we're done  */
+  uint8_t              prefetch_quit;
+} INGEST_SHARED;
+
+
+/*  What each decoder thread gets.  */
+
+typedef struct
+{
+  INGEST_SHARED        *shared;
+  int32_t              thread;
+} DECODER_ARG;
+
+
+
+static void queue_init (BLOCK_QUEUE *queue, int32_t depth)
+{
+  size_t               i, size;
+
+
+  for (size = 2 ; size < (size_t) depth ; size <<= 1);
+
+  queue->cells = (QUEUE_CELL *) malloc (size * sizeof (QUEUE_CELL));
+  if (queue->cells == NULL)
+    {
+      perror ("Allocating block queue");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < size ; i++)
+    {
+      atomic_init (&queue->cells[i].sequence, i);
+      queue->cells[i].block = NULL;
+    }
+
+  queue->mask = size - 1;
+  atomic_init (&queue->enqueue_pos, 0);
+  atomic_init (&queue->dequeue_pos, 0);
+}
+
+
+
+/*  Returns NVFalse if the queue is full.  */
+
+static uint8_t queue_push (BLOCK_QUEUE *queue, READER_BLOCK *block)
+{
+  QUEUE_CELL           *cell;
+  size_t               pos, seq;
+  intptr_t             diff;
+
+
+  pos = atomic_load_explicit (&queue->enqueue_pos, memory_order_relaxed);
+
+  while (1)
+    {
+      cell = &queue->cells[pos & queue->mask];
+      seq = atomic_load_explicit (&cell->sequence, memory_order_acquire);
+      diff = (intptr_t) seq - (intptr_t) pos;
+
+      if (diff == 0)
+        {
+          if (atomic_compare_exchange_weak_explicit (&queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                     memory_order_relaxed)) break;
+        }
+      else if (diff < 0)
+        {
+          return (NVFalse);
+        }
+      else
+        {
+          pos = atomic_load_explicit (&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+  cell->block = block;
+  atomic_store_explicit (&cell->sequence, pos + 1, memory_order_release);
+
+  return (NVTrue);
+}
+
+
+
+/*  Returns NULL if the queue is empty.  */
+
+static READER_BLOCK *queue_pop (BLOCK_QUEUE *queue)
+{
+  QUEUE_CELL           *cell;
+  READER_BLOCK         *block;
+  size_t               pos, seq;
+  intptr_t             diff;
+
+
+  pos = atomic_load_explicit (&queue->dequeue_pos, memory_order_relaxed);
+
+  while (1)
+    {
+      cell = &queue->cells[pos & queue->mask];
+      seq = atomic_load_explicit (&cell->sequence, memory_order_acquire);
+      diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+      if (diff == 0)
+        {
+          if (atomic_compare_exchange_weak_explicit (&queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                     memory_order_relaxed)) break;
+        }
+      else if (diff < 0)
+        {
+          return (NULL);
+        }
+      else
+        {
+          pos = atomic_load_explicit (&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+
+  block = cell->block;
+  atomic_store_explicit (&cell->sequence, pos + queue->mask + 1, memory_order_release);
+
+  return (block);
+}
+
+
+
+/*  Back off while waiting on a full or empty queue.  We spin for a little while, then yield, then sleep so that
+    decoder threads that are waiting on a slow loader don't eat up all of the CPU.  */
+
+static void queue_wait (int32_t *tries)
+{
+  struct timespec      nap = {0, 50000};
+
+
+  (*tries)++;
+
+  if (*tries < 64) return;
+
+  if (*tries < 256)
+    {
+      sched_yield ();
+      return;
+    }
+
+  nanosleep (&nap, NULL);
+}
+
+
+
+static READER_BLOCK *get_empty_block (INGEST_SHARED *shared)
+{
+  READER_BLOCK         *block;
+  int32_t              tries = 0;
+
+
+  while ((block = queue_pop (&shared->empty)) == NULL) queue_wait (&tries);
+
+  return (block);
+}
+
+
+
+static void put_full_block (INGEST_SHARED *shared, READER_BLOCK *block)
+{
+  int32_t              tries = 0;
+
+
+  while (!queue_push (&shared->full, block)) queue_wait (&tries);
+}
+
+
+
+/*  Report a file that can't touch the area.  It counts as done for the progress.  */
+
+static void skip_file (INGEST_SHARED *shared, int32_t file)
+{
+  fprintf (stderr, "\nData file %03d of %03d: %s (outside of the area, skipped)\n", file + 1,
+           shared->params->numfiles, shared->params->files[file]);
+  fflush (stderr);
+
+  atomic_fetch_add (&shared->skipped, 1);
+  atomic_fetch_add_explicit (&shared->percent_sum, 100, memory_order_relaxed);
+}
+
+
+
+/*  Check the summary file for a file.  Returns NVTrue if the file can be skipped.  If there isn't a good summary and
+    the file type is one that gets read in full (GSF, PFM, and point files are culled and windowed inside the reader,
+    and LAS points are filtered by classification, so we never see all of their points) we start building one.  */
+
+static uint8_t check_summary (INGEST_SHARED *shared, int32_t file)
+{
+  INGEST_PARAMS        *params = shared->params;
+  FILE_SUMMARY         summary;
+  uint8_t              outside;
+  int32_t              type;
+
+
+  /*  Pipes can only be read once and don't have a size or time to check a summary against.  */
+
+  if (reader_is_pipe (params->files[file])) return (NVFalse);
+
+  if (summary_read (params->files[file], params->summary_directory, &summary))
+    {
+      outside = (params->reader.cull && !summary_overlaps (&summary, &params->reader.cull_mbr));
+      summary_free (&summary);
+
+      return (outside);
+    }
+
+  type = reader_file_type (params->files[file]);
+  if (type != GSF_FILE && type != PFM_FILE && type != LAS_FILE && type != CH2P_FILE) summary_init (&shared->summaries[file]);
+
+  return (NVFalse);
+}
+
+
+
+/*  Get the next task.  Ranges that were split off of a file come first, otherwise we plan the next file and put any
+    extra ranges on the pending list.  Files that reader_plan says can't contribute are reported and skipped.  Returns
+    NVFalse when there's nothing left to do.  */
+
+static uint8_t get_task (INGEST_SHARED *shared, INGEST_TASK *task)
+{
+  READER_RANGE         *ranges;
+  int32_t              i, count, file, planning;
+
+
+  for (;;)
+    {
+      pthread_mutex_lock (&shared->task_mutex);
+
+      if (shared->pending_head < shared->pending_tail)
+        {
+          *task = shared->pending[shared->pending_head++];
+          pthread_mutex_unlock (&shared->task_mutex);
+          return (NVTrue);
+        }
+
+      if (shared->next_file >= shared->params->numfiles)
+        {
+          /*  Another thread may be about to split a file so hang around until it's done.  */
+
+          planning = shared->planning;
+          pthread_mutex_unlock (&shared->task_mutex);
+
+          if (!planning) return (NVFalse);
+
+          sched_yield ();
+          continue;
+        }
+
+      file = shared->next_file++;
+      shared->planning++;
+
+      pthread_cond_signal (&shared->prefetch_cond);
+
+      pthread_mutex_unlock (&shared->task_mutex);
+
+
+      count = 0;
+
+      if (!shared->params->summaries || !check_summary (shared, file))
+        count = reader_plan (shared->params->files[file], &shared->params->reader, &ranges);
+
+      if (count) break;
+
+
+      /*  The file's bounds (or its summary) don't touch the area.  */
+
+      pthread_mutex_lock (&shared->task_mutex);
+      shared->planning--;
+      pthread_mutex_unlock (&shared->task_mutex);
+
+      if (shared->summaries) summary_free (&shared->summaries[file]);
+
+      skip_file (shared, file);
+    }
+
+  task->file = file;
+  task->part = 0;
+  task->parts = count;
+  task->range = ranges[0];
+
+  pthread_mutex_lock (&shared->task_mutex);
+
+  if (shared->summaries) atomic_store (&shared->parts_left[file], count);
+
+  if (count > 1)
+    {
+      if (shared->pending_tail + count - 1 > shared->pending_size)
+        {
+          shared->pending_size = shared->pending_tail + count - 1 + 64;
+          shared->pending = (INGEST_TASK *) realloc (shared->pending, shared->pending_size * sizeof (INGEST_TASK));
+          if (shared->pending == NULL)
+            {
+              perror ("Allocating ingest tasks");
+              exit (-1);
+            }
+        }
+
+      for (i = 1 ; i < count ; i++)
+        {
+          shared->pending[shared->pending_tail].file = file;
+          shared->pending[shared->pending_tail].part = i;
+          shared->pending[shared->pending_tail].parts = count;
+          shared->pending[shared->pending_tail].range = ranges[i];
+          shared->pending_tail++;
+        }
+
+      atomic_fetch_add (&shared->num_tasks, count - 1);
+    }
+
+  shared->planning--;
+
+  pthread_mutex_unlock (&shared->task_mutex);
+
+  free (ranges);
+
+  return (NVTrue);
+}
+
+
+
+/*  Prefetch thread.  Keeps asking the kernel to start reading (see reader_prefetch) the next prefetch_files files
+    that haven't been handed to a decoder yet so that, on slow or network disks, their first blocks are already cached
+    when a decoder gets to them.  Opening the files here also takes the metadata round trips off of the decoders.  */
+
+static void *prefetcher (void *arg)
+{
+  INGEST_SHARED        *shared = (INGEST_SHARED *) arg;
+  INGEST_PARAMS        *params = shared->params;
+  int32_t              file = 0, limit;
+
+
+  pthread_mutex_lock (&shared->task_mutex);
+
+  while (!shared->prefetch_quit && file < params->numfiles)
+    {
+      file = MAX (file, shared->next_file);
+      limit = MIN (shared->next_file + params->prefetch_files, params->numfiles);
+
+      if (file >= limit)
+        {
+          if (file < params->numfiles) pthread_cond_wait (&shared->prefetch_cond, &shared->task_mutex);
+          continue;
+        }
+
+      pthread_mutex_unlock (&shared->task_mutex);
+
+      reader_prefetch (params->files[file++]);
+
+      pthread_mutex_lock (&shared->task_mutex);
+    }
+
+  pthread_mutex_unlock (&shared->task_mutex);
+
+  return (NULL);
+}
+
+
+
+/*  Decoder thread.  Keep grabbing tasks until they're all gone.  */
+
+static void *decoder (void *arg)
+{
+  INGEST_SHARED        *shared = ((DECODER_ARG *) arg)->shared;
+  int32_t              thread = ((DECODER_ARG *) arg)->thread;
+  INGEST_PARAMS        *params = shared->params;
+  INGEST_TASK          task;
+  READER_CONTEXT       *ctx;
+  READER_BLOCK         *block;
+  FILE_SUMMARY         part, *summary;
+  int32_t              percent, old_percent;
+
+
+  while (get_task (shared, &task))
+    {
+      summary = NULL;
+      if (shared->summaries && shared->summaries[task.file].occupancy != NULL)
+        {
+          summary = &part;
+          summary_init (summary);
+        }
+
+      if (task.parts > 1)
+        {
+          fprintf (stderr, "\nData file %03d of %03d: %s (part %d of %d)\n", task.file + 1, params->numfiles,
+                   params->files[task.file], task.part + 1, task.parts);
+        }
+      else
+        {
+          fprintf (stderr, "\nData file %03d of %03d: %s\n", task.file + 1, params->numfiles, params->files[task.file]);
+        }
+      fflush (stderr);
+
+      if ((ctx = reader_open_range (params->files[task.file], &task.range, &params->reader)) == NULL)
+        exit (-1);
+
+      block = get_empty_block (shared);
+      old_percent = 0;
+
+      while (!reader_read (ctx, block))
+        {
+          percent = reader_percent (ctx);
+          atomic_fetch_add_explicit (&shared->percent_sum, percent - old_percent, memory_order_relaxed);
+          old_percent = percent;
+
+          if (summary != NULL) summary_add (summary, block);
+
+          atomic_fetch_add_explicit (&shared->points, block->count, memory_order_relaxed);
+
+          if (params->thread_load != NULL)
+            {
+              (*params->thread_load) (thread, block, shared->user_data);
+            }
+          else
+            {
+              put_full_block (shared, block);
+              block = get_empty_block (shared);
+            }
+        }
+
+      atomic_fetch_add_explicit (&shared->percent_sum, 100 - old_percent, memory_order_relaxed);
+
+
+      /*  The last read didn't give us anything so put the block back.  */
+
+      while (!queue_push (&shared->empty, block));
+
+      atomic_fetch_add (&shared->culled, reader_culled (ctx));
+
+      reader_close (ctx);
+
+      if (params->thread_done != NULL) (*params->thread_done) (thread, shared->user_data);
+
+
+      /*  Once every range of the file has been read we can write its summary.  The merge only locks this file's
+          summary, and every range merges before it counts itself off, so whoever takes the count to zero has the whole
+          summary to itself and can write it without holding anything.  */
+
+      if (summary != NULL)
+        {
+          pthread_mutex_lock (&shared->summary_mutex[task.file]);
+          summary_merge (&shared->summaries[task.file], summary);
+          pthread_mutex_unlock (&shared->summary_mutex[task.file]);
+
+          summary_free (summary);
+
+          if (atomic_fetch_sub (&shared->parts_left[task.file], 1) == 1)
+            {
+              summary_write (params->files[task.file], params->summary_directory, &shared->summaries[task.file]);
+              summary_free (&shared->summaries[task.file]);
+            }
+        }
+    }
+
+  atomic_fetch_sub (&shared->active, 1);
+
+  return (NULL);
+}
+
+
+
+/*  Show the progress (the percentage of the tasks read or, if we're reading a pipe, the number of points).  */
+
+static void show_progress (INGEST_SHARED *shared, uint8_t pipes, int32_t *old_percent, int64_t *old_points)
+{
+  int32_t              percent;
+  int64_t              points;
+
+
+  if (pipes)
+    {
+      points = atomic_load_explicit (&shared->points, memory_order_relaxed);
+
+      if (points - *old_points >= INGEST_POINTS_REPORT)
+        {
+          fprintf (stderr, "%" PRId64 " points processed             \r", points);
+          fflush (stderr);
+          *old_points = points;
+        }
+      return;
+    }
+
+  percent = atomic_load_explicit (&shared->percent_sum, memory_order_relaxed) / atomic_load (&shared->num_tasks);
+
+  if (*old_percent != percent)
+    {
+      fprintf (stderr, "%3d%% processed             \r", percent);
+      fflush (stderr);
+      *old_percent = percent;
+    }
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        ingest_processors                                   *
+*                                                                           *
+*   Purpose:            Return the number of online processors.             *
+*                                                                           *
+\***************************************************************************/
+
+int32_t ingest_processors ()
+{
+  int32_t              num = 1;
+
+#ifdef NVWIN3X
+  SYSTEM_INFO          info;
+
+  GetSystemInfo (&info);
+  num = info.dwNumberOfProcessors;
+#else
+  num = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+  if (num < 1) num = 1;
+
+  return (num);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        ingest                                              *
+*                                                                           *
+*   Purpose:            Read all of the input files in parallel and pass    *
+*                       the point blocks to the load function (or, if       *
+*                       params->thread_load is set, to thread_load on the   *
+*                       decoder threads).                                   *
+*                                                                           *
+*   Inputs:             params      -   ingest parameters                   *
+*                       load        -   function called (on this thread)    *
+*                                       for each block of points            *
+*                       user_data   -   passed through to load              *
+*                                                                           *
+*   Outputs:            int32_t     -   0 on success, -1 on failure         *
+*                                                                           *
+\***************************************************************************/
+
+int32_t ingest (INGEST_PARAMS *params, INGEST_LOAD load, void *user_data)
+{
+  INGEST_SHARED        shared;
+  pthread_t            *threads, prefetch_thread;
+  READER_BLOCK         **blocks, *block;
+  DECODER_ARG          *args;
+  int32_t              i, num_threads, queue_depth, tries, old_percent;
+  int64_t              old_points;
+  uint8_t              pipes;
+
+
+  params->culled = 0;
+  params->skipped = 0;
+
+  if (!params->numfiles) return (0);
+
+
+  /*  This isn't limited to the number of files.  A single big file is split into ranges by reader_plan and the other
+      threads wait in get_task while it's being planned and then take the ranges.  */
+
+  num_threads = params->num_threads;
+  if (num_threads <= 0) num_threads = ingest_processors ();
+
+
+  /*  With fewer files than threads ask reader_plan for enough ranges from each file to keep all of them busy.  */
+
+  params->reader.min_ranges = (num_threads + params->numfiles - 1) / params->numfiles;
+
+
+  /*  Each decoder needs a block to work on and the loader needs one too.  */
+
+  queue_depth = params->queue_depth;
+  if (queue_depth <= 0) queue_depth = num_threads * INGEST_BLOCKS_PER_THREAD;
+  if (queue_depth < num_threads + 1) queue_depth = num_threads + 1;
+
+
+  memset (&shared, 0, sizeof (INGEST_SHARED));
+  shared.params = params;
+
+  queue_init (&shared.full, queue_depth);
+  queue_init (&shared.empty, queue_depth);
+  pthread_mutex_init (&shared.task_mutex, NULL);
+  pthread_cond_init (&shared.prefetch_cond, NULL);
+  shared.prefetch_quit = NVFalse;
+  shared.user_data = user_data;
+  atomic_init (&shared.points, 0);
+  shared.pending = NULL;
+  shared.pending_head = shared.pending_tail = shared.pending_size = 0;
+  shared.next_file = 0;
+  shared.planning = 0;
+  atomic_init (&shared.num_tasks, params->numfiles);
+  atomic_init (&shared.active, num_threads);
+  atomic_init (&shared.percent_sum, 0);
+  atomic_init (&shared.culled, 0);
+  atomic_init (&shared.skipped, 0);
+
+  if (params->summaries)
+    {
+      shared.summaries = (FILE_SUMMARY *) calloc (params->numfiles, sizeof (FILE_SUMMARY));
+      shared.summary_mutex = (pthread_mutex_t *) malloc (params->numfiles * sizeof (pthread_mutex_t));
+      shared.parts_left = (atomic_int *) malloc (params->numfiles * sizeof (atomic_int));
+
+      if (shared.summaries == NULL || shared.summary_mutex == NULL || shared.parts_left == NULL)
+        {
+          perror ("Allocating file summaries");
+          exit (-1);
+        }
+
+      for (i = 0 ; i < params->numfiles ; i++)
+        {
+          pthread_mutex_init (&shared.summary_mutex[i], NULL);
+          atomic_init (&shared.parts_left[i], 0);
+        }
+    }
+
+  blocks = (READER_BLOCK **) malloc (queue_depth * sizeof (READER_BLOCK *));
+  threads = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+  args = (DECODER_ARG *) malloc (num_threads * sizeof (DECODER_ARG));
+
+  if (blocks == NULL || threads == NULL || args == NULL)
+    {
+      perror ("Allocating ingest buffers");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < queue_depth ; i++)
+    {
+      blocks[i] = reader_block_alloc (READER_BLOCK_SIZE);
+      queue_push (&shared.empty, blocks[i]);
+    }
+
+
+  fprintf (stderr, "\n\nReading %d files with %d decoder threads\n\n", params->numfiles, num_threads);
+  fflush (stderr);
+
+
+  for (i = 0 ; i < num_threads ; i++)
+    {
+      args[i].shared = &shared;
+      args[i].thread = i;
+
+      if (pthread_create (&threads[i], NULL, decoder, &args[i]))
+        {
+          perror ("Starting decoder thread");
+          exit (-1);
+        }
+    }
+
+  if (params->prefetch_files > 0 && pthread_create (&prefetch_thread, NULL, prefetcher, &shared))
+    {
+      perror ("Starting prefetch thread");
+      exit (-1);
+    }
+
+
+  /*  Load everything that the decoders hand us.  We have to check for data again after we see that all of the decoders
+      are finished since they may have pushed a block between our pop and our check of active.  */
+
+  /*  If we're reading from a pipe the percentage doesn't mean anything (we don't know how much is coming) so we report
+      the number of points instead.  */
+
+  pipes = NVFalse;
+  for (i = 0 ; i < params->numfiles ; i++) pipes |= reader_is_pipe (params->files[i]);
+
+  old_percent = -1;
+  old_points = 0;
+  tries = 0;
+
+  while (1)
+    {
+      if ((block = queue_pop (&shared.full)) == NULL)
+        {
+          if (!atomic_load (&shared.active) && (block = queue_pop (&shared.full)) == NULL) break;
+
+          if (block == NULL)
+            {
+              /*  With thread_load we never get any blocks so this is the only place we show progress.  */
+
+              if (tries >= 256) show_progress (&shared, pipes, &old_percent, &old_points);
+
+              queue_wait (&tries);
+              continue;
+            }
+        }
+
+      tries = 0;
+
+      (*load) (block, user_data);
+
+      while (!queue_push (&shared.empty, block));
+
+      show_progress (&shared, pipes, &old_percent, &old_points);
+    }
+
+
+  for (i = 0 ; i < num_threads ; i++) pthread_join (threads[i], NULL);
+
+  if (params->prefetch_files > 0)
+    {
+      pthread_mutex_lock (&shared.task_mutex);
+      shared.prefetch_quit = NVTrue;
+      pthread_cond_signal (&shared.prefetch_cond);
+      pthread_mutex_unlock (&shared.task_mutex);
+
+      pthread_join (prefetch_thread, NULL);
+    }
+
+  params->culled = atomic_load (&shared.culled);
+  params->skipped = atomic_load (&shared.skipped);
+
+  for (i = 0 ; i < queue_depth ; i++) reader_block_free (blocks[i]);
+
+  pthread_mutex_destroy (&shared.task_mutex);
+  pthread_cond_destroy (&shared.prefetch_cond);
+  free (shared.pending);
+  if (shared.summaries)
+    {
+      for (i = 0 ; i < params->numfiles ; i++) pthread_mutex_destroy (&shared.summary_mutex[i]);
+    }
+
+  free (shared.summaries);
+  free (shared.summary_mutex);
+  free (shared.parts_left);
+  free (shared.full.cells);
+  free (shared.empty.cells);
+  free (blocks);
+  free (threads);
+  free (args);
+
+  return (0);
+}
@@ -0,0 +1,96 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+#ifndef __CHRTR2_INGEST_H__
+#define __CHRTR2_INGEST_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "reader.h"
+
+
+/*  Number of point blocks in flight per decoder thread if the queue depth isn't specified.  */
+
+#define         INGEST_BLOCKS_PER_THREAD        4
+
+
+/*  Default number of files ahead of the decoders to prefetch (see reader_prefetch).  */
+
+#define         INGEST_PREFETCH_FILES           8
+
+
+/*  When any of the input files is a pipe, progress is reported every this many points.  */
+
+#define         INGEST_POINTS_REPORT            1000000
+
+
+/*  Called on a decoder thread (numbered from 0 to one less than the number of decoder threads) for each block of points
+    that it produces, if INGEST_PARAMS thread_load is set.  */
+
+typedef void (*INGEST_THREAD_LOAD) (int32_t thread, READER_BLOCK *block, void *user_data);
+
+
+/*  Called on a decoder thread each time it finishes reading a file (or part of one), if INGEST_PARAMS thread_done is
+    set.  */
+
+typedef void (*INGEST_THREAD_DONE) (int32_t thread, void *user_data);
+
+
+/*  Ingest parameters.  Setting num_threads or queue_depth to 0 gets you the defaults (one decoder thread per
+    processor and INGEST_BLOCKS_PER_THREAD blocks per decoder thread).  */
+
+typedef struct
+{
+  char          **files;                    /*  Input file names  */
+  int32_t       numfiles;                   /*  Number of input files  */
+  READER_OPTIONS reader;                     /*  Options passed to reader_open_range  */
+  int32_t       num_threads;                /*  Number of decoder threads  */
+  int32_t       queue_depth;                /*  Number of point blocks in the queue  */
+  int32_t       prefetch_files;             /*  Number of upcoming files to prefetch (0 for none)  */
+  INGEST_THREAD_LOAD thread_load;           /*  If set, blocks go to this on the decoder threads instead of to load  */
+  INGEST_THREAD_DONE thread_done;           /*  If set, called on the decoder threads after each file or range  */
+  uint8_t       summaries;                  /*  Use and build file summaries (see summary.c)  */
+  char          *summary_directory;         /*  Where to keep file summaries (NULL to put them next to the files)  */
+  int64_t       culled;                     /*  Returned: number of GSF pings culled (see READER_OPTIONS)  */
+  int64_t       skipped;                    /*  Returned: number of files skipped because of their bounds  */
+} INGEST_PARAMS;
+
+
+/*  Called on the thread that called ingest for every block of points that the decoder threads produce.  */
+
+typedef void (*INGEST_LOAD) (READER_BLOCK *block, void *user_data);
+
+
+int32_t ingest_processors ();
+int32_t ingest (INGEST_PARAMS *params, INGEST_LOAD load, void *user_data);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,253 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        las                                                 *
+*                                                                           *
+*   Purpose:            Read the header and decode the point records of     *
+*                       LAS 1.2 through 1.4 (ASPRS LASer) files.  All of    *
+*                       the fields are little endian on disk and are pulled *
+*                       out a byte at a time so this works on any host (the *
+*                       compilers turn the little endian loads into plain   *
+*                       loads on little endian hosts).  LAZ (compressed)    *
+*                       point records are not supported.                    *
+*                                                                           *
+\***************************************************************************/
+
+#include "las.h"
+
+
+/*  Size of the LAS 1.4 header, which has everything we read.  Older headers are shorter.  */
+
+#define LAS_HEADER_MAX          375
+
+
+/*  The legacy point formats (0-5) keep the classification in the low five bits of byte 15 with the withheld flag in
+    the top bit.  The extended formats (6-10) have the flags in byte 15 and a full byte of classification in byte 16.  */
+
+#define LAS_FLAG_BYTE           15
+#define LAS_LEGACY_CLASS_BYTE   15
+#define LAS_LEGACY_CLASS_MASK   0x1f
+#define LAS_LEGACY_WITHHELD     0x80
+#define LAS_EXTENDED_CLASS_BYTE 16
+#define LAS_EXTENDED_CLASS_MASK 0xff
+#define LAS_EXTENDED_WITHHELD   0x04
+
+
+
+static uint16_t get_u16 (const uint8_t *p)
+{
+  return ((uint16_t) p[0] | ((uint16_t) p[1] << 8));
+}
+
+
+static uint32_t get_u32 (const uint8_t *p)
+{
+  return ((uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+
+static uint64_t get_u64 (const uint8_t *p)
+{
+  return ((uint64_t) get_u32 (p) | ((uint64_t) get_u32 (p + 4) << 32));
+}
+
+
+static double get_f64 (const uint8_t *p)
+{
+  uint64_t             bits = get_u64 (p);
+  double               value;
+
+
+  memcpy (&value, &bits, sizeof (double));
+
+  return (value);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        las_read_header                                     *
+*                                                                           *
+*   Purpose:            Read the public header block of a LAS file.  The    *
+*                       file is left positioned just after the header.      *
+*                                                                           *
+*   Inputs:             fp          -   LAS file, positioned at the start   *
+*                       file        -   file name (for error messages)      *
+*                       head        -   header                              *
+*                                                                           *
+*   Outputs:            int32_t     -   0 on success, -1 on failure (the    *
+*                                       error will have been printed)       *
+*                                                                           *
+\***************************************************************************/
+
+int32_t las_read_header (FILE *fp, char *file, LAS_HEADER *head)
+{
+  uint8_t              buf[LAS_HEADER_MAX];
+  uint16_t             header_size;
+  int32_t              i;
+  int64_t              len;
+
+
+  memset (head, 0, sizeof (LAS_HEADER));
+
+  len = fread (buf, 1, LAS_HEADER_MAX, fp);
+
+  if (len < 227 || memcmp (buf, "LASF", 4))
+    {
+      fprintf (stderr, "\n\nFile %s is not a LAS file\n", file);
+      fflush (stderr);
+      return (-1);
+    }
+
+  head->version_major = buf[24];
+  head->version_minor = buf[25];
+  header_size = get_u16 (&buf[94]);
+  head->point_offset = get_u32 (&buf[96]);
+
+
+  /*  The top two bits of the format are set for LAZ files.  */
+
+  head->point_format = buf[104];
+  head->record_length = get_u16 (&buf[105]);
+  head->num_points = get_u32 (&buf[107]);
+
+  for (i = 0 ; i < 3 ; i++)
+    {
+      head->scale[i] = get_f64 (&buf[131 + i * 8]);
+      head->offset[i] = get_f64 (&buf[155 + i * 8]);
+    }
+
+  head->max_x = get_f64 (&buf[179]);
+  head->min_x = get_f64 (&buf[187]);
+  head->max_y = get_f64 (&buf[195]);
+  head->min_y = get_f64 (&buf[203]);
+  head->max_z = get_f64 (&buf[211]);
+  head->min_z = get_f64 (&buf[219]);
+
+
+  /*  LAS 1.4 has a 64 bit point count (the legacy count is 0 for formats 6 through 10).  */
+
+  if (head->version_minor >= 4 && header_size >= LAS_HEADER_MAX && len >= LAS_HEADER_MAX)
+    head->num_points = get_u64 (&buf[247]);
+
+  fseeko (fp, header_size, SEEK_SET);
+
+
+  if (head->version_major != 1 || head->version_minor < 2 || head->version_minor > 4)
+    {
+      fprintf (stderr, "\n\nFile %s is LAS version %d.%d, only 1.2 through 1.4 are supported\n", file,
+               head->version_major, head->version_minor);
+      fflush (stderr);
+      return (-1);
+    }
+
+  if (head->point_format > 10)
+    {
+      fprintf (stderr, "\n\nFile %s has compressed or unknown point format %d\n", file, head->point_format);
+      fflush (stderr);
+      return (-1);
+    }
+
+  if (head->record_length < (head->point_format < 6 ? 20 : 30))
+    {
+      fprintf (stderr, "\n\nFile %s has a bad point record length (%d)\n", file, head->record_length);
+      fflush (stderr);
+      return (-1);
+    }
+
+
+  /*  We have no way to reproject so the points have to be in degrees already.  */
+
+  if (head->num_points && (head->min_x < -360.0 || head->max_x > 360.0 || head->min_y < -90.0 || head->max_y > 90.0))
+    {
+      fprintf (stderr, "\n\nFile %s does not appear to be in geographic coordinates (X %f to %f, Y %f to %f)\n", file,
+               head->min_x, head->max_x, head->min_y, head->max_y);
+      fflush (stderr);
+      return (-1);
+    }
+
+  return (0);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        las_decode                                          *
+*                                                                           *
+*   Purpose:            Convert a block of point records to longitude,      *
+*                       latitude, and Z (positive down, so the sign of the  *
+*                       LAS elevation is flipped).  Withheld points and     *
+*                       points whose classification is set in skip are      *
+*                       dropped.  Every record is written and the count     *
+*                       only advances for the keepers so there are no       *
+*                       branches in the loop.                               *
+*                                                                           *
+*   Inputs:             head        -   header from las_read_header         *
+*                       records     -   count point records                 *
+*                       count       -   number of records                   *
+*                       skip        -   256 flags, non-zero for the         *
+*                                       classifications to drop             *
+*                       x, y, z     -   output (room for count points)      *
+*                                                                           *
+*   Outputs:            int64_t     -   number of points kept               *
+*                                                                           *
+\***************************************************************************/
+
+int64_t las_decode (LAS_HEADER *head, const uint8_t *records, int64_t count, const uint8_t *skip, double *x, double *y,
+                    double *z)
+{
+  const uint8_t        *rec;
+  int64_t              i, kept = 0;
+  int32_t              class_byte, class_mask, withheld_mask;
+
+
+  if (head->point_format < 6)
+    {
+      class_byte = LAS_LEGACY_CLASS_BYTE;
+      class_mask = LAS_LEGACY_CLASS_MASK;
+      withheld_mask = LAS_LEGACY_WITHHELD;
+    }
+  else
+    {
+      class_byte = LAS_EXTENDED_CLASS_BYTE;
+      class_mask = LAS_EXTENDED_CLASS_MASK;
+      withheld_mask = LAS_EXTENDED_WITHHELD;
+    }
+
+  for (i = 0 ; i < count ; i++)
+    {
+      rec = records + i * head->record_length;
+
+      x[kept] = (int32_t) get_u32 (rec) * head->scale[0] + head->offset[0];
+      y[kept] = (int32_t) get_u32 (rec + 4) * head->scale[1] + head->offset[1];
+      z[kept] = -((int32_t) get_u32 (rec + 8) * head->scale[2] + head->offset[2]);
+
+      kept += !(skip[rec[class_byte] & class_mask] | (rec[LAS_FLAG_BYTE] & withheld_mask));
+    }
+
+  return (kept);
+}
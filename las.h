@@ -0,0 +1,68 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+
+#ifndef __CHRTR2_LAS_H__
+#define __CHRTR2_LAS_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+
+
+/*  The parts of a LAS 1.2, 1.3, or 1.4 public header block that we need.  The bounds are in the file's units which,
+    for chrtr2, have to be geographic (longitude and latitude in degrees).  */
+
+typedef struct
+{
+  uint8_t       version_major;
+  uint8_t       version_minor;
+  uint8_t       point_format;               /*  Point data record format (0 through 10)  */
+  uint16_t      record_length;              /*  Point data record length in bytes  */
+  uint64_t      point_offset;               /*  Offset from the start of the file to the first point record  */
+  uint64_t      num_points;
+  double        scale[3];                   /*  X, Y, Z scale factors  */
+  double        offset[3];                  /*  X, Y, Z offsets  */
+  double        min_x;
+  double        max_x;
+  double        min_y;
+  double        max_y;
+  double        min_z;
+  double        max_z;
+} LAS_HEADER;
+
+
+int32_t las_read_header (FILE *fp, char *file, LAS_HEADER *head);
+int64_t las_decode (LAS_HEADER *head, const uint8_t *records, int64_t count, const uint8_t *skip, double *x, double *y,
+                    double *z);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
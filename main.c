@@ -42,42 +42,202 @@
 *                                                                           *
 \***************************************************************************/
 
+#include <inttypes.h>
+#include <pthread.h>
+
 #include "nvutility.h"
 
 #include "misp.h"
 #include "chrtr2.h"
 
+#include "reader.h"
+#include "ingest.h"
+#include "pointfile.h"
+#include "prebin.h"
+#include "spill.h"
+#include "surface.h"
 #include "version.h"
 
 
+
+/*  Everything load_block needs to move points into the grid domain and load them into MISP.  */
+
+typedef struct
+{
+  NV_F64_MBR    mbr;
+  double        x_griddeg;
+  double        y_griddeg;
+  int64_t       out_of_area;
+  int64_t       num_points;
+  POINTFILE_WRITER *writer;                 /*  Point file to save the points in (NULL if not wanted)  */
+  pthread_mutex_t writer_mutex;             /*  For the writer when the decoder threads call prebin_block  */
+  PREBIN        *prebin;                    /*  Cell accumulators if [prebin] or [thin_factor] is set  */
+  int64_t       num_cells;                  /*  Binned points actually loaded into MISP  */
+  SPILL         *spill;                     /*  Spill sort if [sort_directory] is set  */
+} LOAD_DATA;
+
+
+
+/*  Load a block of points from the ingest queue into MISP.  This is always called from the main thread.  */
+
+static void load_block (READER_BLOCK *block, void *user_data)
+{
+  LOAD_DATA     *load = (LOAD_DATA *) user_data;
+  NV_F64_COORD3 xyz;
+  int32_t       i;
+
+
+  if (load->writer != NULL) pointfile_add (load->writer, block);
+
+
+  /*  With [sort_directory] set the points are sorted into grid cell order first and load_point loads them.  */
+
+  if (load->spill != NULL)
+    {
+      spill_add (load->spill, block);
+      return;
+    }
+
+  for (i = 0 ; i < block->count ; i++)
+    {
+      /*  Move the lat and lon minutes into the grid domain.  */
+
+      /*  IMPORTANT NOTE: Since MISP always wants to create a grid that has points at the corners of each cell and we want a grid
+          with points at the center of each cell we're going to cheat a bit more here.  We have told MISP that the grid spacing
+          is 1.0 in both directions (clever, no) so we are going to add .5 to the X and Y positions so that MISP will build a
+          grid with points at the cell centers.  */
+
+
+      /* we no longer need the half node shift since we moved chrtr2 to grid registration -SJ */
+
+      xyz.x = (block->x[i] - load->mbr.wlon) / load->x_griddeg;  /* + 0.5;*/
+      xyz.y = (block->y[i] - load->mbr.slat) / load->y_griddeg;  /* + 0.5;*/
+      xyz.z = block->z[i];
+
+
+      /*  Load data and check for out of area conditions.  */
+
+      if (!misp_load (xyz))
+        {
+          load->out_of_area++;
+        }
+      else
+        {
+          load->num_points++;
+        }
+    }
+}
+
+
+
+/*  With [prebin] set the decoder threads bin their own points (see prebin.c) and this is called on each of them
+    instead of load_block.  */
+
+static void prebin_block (int32_t thread, READER_BLOCK *block, void *user_data)
+{
+  LOAD_DATA     *load = (LOAD_DATA *) user_data;
+
+
+  if (load->writer != NULL)
+    {
+      pthread_mutex_lock (&load->writer_mutex);
+      pointfile_add (load->writer, block);
+      pthread_mutex_unlock (&load->writer_mutex);
+    }
+
+  prebin_add (load->prebin, thread, block);
+}
+
+
+
+/*  Called on a decoder thread when it finishes a file (or part of one) so its cells are folded into the shared set
+    instead of piling up on every thread until the end.  */
+
+static void prebin_done (int32_t thread, void *user_data)
+{
+  LOAD_DATA     *load = (LOAD_DATA *) user_data;
+
+
+  prebin_flush (load->prebin, thread);
+}
+
+
+
+/*  Load one point from the spill sort (already in the grid domain) into MISP.  */
+
+static void load_point (NV_F64_COORD3 xyz, void *user_data)
+{
+  LOAD_DATA     *load = (LOAD_DATA *) user_data;
+
+
+  if (!misp_load (xyz))
+    {
+      load->out_of_area++;
+    }
+  else
+    {
+      load->num_points++;
+    }
+}
+
+
+
+/*  Load one binned cell (already in the grid domain) into MISP.  */
+
+static void load_cell (NV_F64_COORD3 xyz, int64_t count, void *user_data)
+{
+  LOAD_DATA     *load = (LOAD_DATA *) user_data;
+
+
+  if (!misp_load (xyz))
+    {
+      load->out_of_area += count;
+    }
+  else
+    {
+      load->num_points += count;
+      load->num_cells++;
+    }
+}
+
+
+
 int32_t main (int32_t argc, char *argv[])
 {
   FILE          *chp_fp;
 
-  int32_t       i, j, k, m, error_control, gridcols, gridrows, reg_multfact, weight_factor, dn, up, bw, fw, chrtr2_hnd, row,
-                numfiles, out_of_area, num_points, nibble, percent, old_percent, tmp_i;
+  int32_t       i, j, error_control, gridcols, gridrows, reg_multfact, weight_factor, chrtr2_hnd, row,
+                numfiles, nibble, percent, old_percent, tmp_i, reader_threads, queue_depth, max_files, prefetch_files,
+                thin_factor, thin_method, sort_memory_mb;
+
+  int64_t       out_of_area, num_points;
 
   double        delta, y_griddeg, x_griddeg, center_x, center_y, maxvalue, minvalue, search_radius, tmp_pos, x, y,
-                in_gridmin = 0.0, in_gridmeter = 0.0;
+                in_gridmin = 0.0, in_gridmeter = 0.0, grid_size;
 
   float         *array;
 
-  uint8_t       **val_array = NULL, input_file_flag, force_original_value = NVFalse, nominal = NVFalse, dateline, found;
+  uint8_t       *row_flags = NULL, input_file_flag, force_original_value = NVFalse, nominal = NVFalse, dateline,
+                fast_geolocation = NVTrue, file_summaries = NVFalse, prebin = NVFalse;
 
   NV_F64_XYMBR  mbr;
 
   NV_F64_MBR    in_mbr = {0.0, 0.0, 0.0, 0.0};
 
-  NV_F64_COORD3 xyz;
+  INGEST_PARAMS ingest_params;
+
+  LOAD_DATA     load;
 
-  char          chrtr2file[512], *input_filenames[4000], chp_file[512], varin[1024], info[1024];
+  char          chrtr2file[512], **input_filenames = NULL, chp_file[512], varin[1024], info[1024], index_directory[512],
+                las_classes[512], *token, point_file[512], sort_directory[512];
 
   CHRTR2_HEADER chrtr2_header;
 
-  CHRTR2_RECORD *chrtr2_array, chrtr2_record;
+  CHRTR2_RECORD *chrtr2_array;
+
+  SURFACE       *surface = NULL;
 
 
-  int32_t reader (NV_F64_COORD3 *, int32_t, char *[], int32_t, uint8_t);
   void loadfiles (char *[], int32_t *);
 
 
@@ -107,8 +267,16 @@ int32_t main (int32_t argc, char *argv[])
   search_radius = 20.0;
   out_of_area = 0;
   num_points = 0;
-
-  xyz.x = xyz.y = xyz.z = 0.0;
+  reader_threads = 0;
+  queue_depth = 0;
+  prefetch_files = INGEST_PREFETCH_FILES;
+  thin_factor = 0;
+  thin_method = 0;
+  sort_memory_mb = SPILL_MEMORY_MB;
+  sort_directory[0] = 0;
+  index_directory[0] = 0;
+  las_classes[0] = 0;
+  point_file[0] = 0;
 
 
   strcpy (chp_file, argv[1]);
@@ -121,6 +289,7 @@ int32_t main (int32_t argc, char *argv[])
 
   input_file_flag = NVFalse;
   numfiles = 0;
+  max_files = 0;
   while (ngets (varin, sizeof (varin), chp_fp) != NULL)
     {
       /*  Put everything to the right of the equals sign in 'info'.   */
@@ -146,6 +315,35 @@ int32_t main (int32_t argc, char *argv[])
           sscanf (info, "%d", &tmp_i);
           nominal = (uint8_t) tmp_i;
         }
+
+      /*  The tangent plane beam positioning is the default since every ping is checked against newgp (see
+          geolocate.c).  Setting it to 0 positions every beam with newgp.  */
+
+      if (strstr (varin, "[gsf_fast_geolocation]"))
+        {
+          sscanf (info, "%d", &tmp_i);
+          fast_geolocation = (uint8_t) tmp_i;
+        }
+      if (strstr (varin, "[file_summaries]"))
+        {
+          sscanf (info, "%d", &tmp_i);
+          file_summaries = (uint8_t) tmp_i;
+        }
+      if (strstr (varin, "[index_directory]")) get_string (varin, index_directory);
+      if (strstr (varin, "[las_classes]")) get_string (varin, las_classes);
+      if (strstr (varin, "[point_file]")) get_string (varin, point_file);
+      if (strstr (varin, "[reader_threads]")) sscanf (info, "%d", &reader_threads);
+      if (strstr (varin, "[reader_queue_depth]")) sscanf (info, "%d", &queue_depth);
+      if (strstr (varin, "[prefetch_files]")) sscanf (info, "%d", &prefetch_files);
+      if (strstr (varin, "[prebin]"))
+        {
+          sscanf (info, "%d", &tmp_i);
+          prebin = (uint8_t) tmp_i;
+        }
+      if (strstr (varin, "[thin_factor]")) sscanf (info, "%d", &thin_factor);
+      if (strstr (varin, "[thin_method]")) sscanf (info, "%d", &thin_method);
+      if (strstr (varin, "[sort_directory]")) get_string (varin, sort_directory);
+      if (strstr (varin, "[sort_memory_mb]")) sscanf (info, "%d", &sort_memory_mb);
       if (strstr (varin, "[minvalue]")) sscanf (info, "%lf", &minvalue);
       if (strstr (varin, "[maxvalue]")) sscanf (info, "%lf", &maxvalue);
       if (strstr (varin, "[lat_south]")) 
@@ -174,6 +372,17 @@ int32_t main (int32_t argc, char *argv[])
         {
           if (strstr (varin, "**  End Input Files  **")) break;
 
+          if (numfiles == max_files)
+            {
+              max_files = MAX (max_files * 2, 4096);
+              input_filenames = (char **) realloc (input_filenames, max_files * sizeof (char *));
+              if (input_filenames == NULL)
+                {
+                  perror ("Allocating input file list");
+                  exit (-1);
+                }
+            }
+
           input_filenames[numfiles] = (char *) malloc (strlen (varin) + 1);
           strcpy (input_filenames[numfiles], varin);
           numfiles++;
@@ -223,7 +432,15 @@ int32_t main (int32_t argc, char *argv[])
 
   /*SJ - adjust for change to grid orientation*/
 
-  gridrows = (int32_t) ceil(((in_mbr.nlat - in_mbr.slat) / y_griddeg)-.5) + 1;
+  grid_size = ceil(((in_mbr.nlat - in_mbr.slat) / y_griddeg)-.5) + 1.0;
+
+  if (grid_size > (double) INT32_MAX)
+    {
+      fprintf (stderr, "\n\nToo many rows (%.0f) for the requested area and grid size.\nTerminating!\n\n", grid_size);
+      exit (-1);
+    }
+
+  gridrows = (int32_t) grid_size;
 
 
   /*  WARNING - the following code is non-functional (you can't get lats larger than 90.0).  We may use this in the
@@ -256,7 +473,15 @@ int32_t main (int32_t argc, char *argv[])
 
   /*SJ - adjust for change to grid orientation*/
 
-  gridcols = (int32_t) ceil(((in_mbr.elon - in_mbr.wlon) / x_griddeg)-.5) + 1;
+  grid_size = ceil(((in_mbr.elon - in_mbr.wlon) / x_griddeg)-.5) + 1.0;
+
+  if (grid_size > (double) INT32_MAX)
+    {
+      fprintf (stderr, "\n\nToo many columns (%.0f) for the requested area and grid size.\nTerminating!\n\n", grid_size);
+      exit (-1);
+    }
+
+  gridcols = (int32_t) grid_size;
 
 
   /*  Add .ch2 extension to output file if it isn't already there.  */
@@ -325,40 +550,171 @@ int32_t main (int32_t argc, char *argv[])
                      (float) minvalue, weight_factor, mbr)) return (-1);
 
 
-      /*  Load all the data from the given input files.  */
+      /*  Load all the data from the given input files.  The files are decoded by a pool of reader threads but all of the
+          loading into MISP happens on this thread.  */
 
-      while (1)
-        {
-          if (reader (&xyz, dateline, input_filenames, numfiles, nominal)) break;
+      load.mbr = in_mbr;
+      load.x_griddeg = x_griddeg;
+      load.y_griddeg = y_griddeg;
+      load.out_of_area = 0;
+      load.num_points = 0;
 
 
-          /*  Move the lat and lon minutes into the grid domain.  */
+      /*  If [point_file] is set, every point the readers hand us is also saved in a point file (see pointfile.h) that
+          can be used as an input file on later runs.  The writer sorts the points with the same spill sort as
+          [sort_directory] (in [sort_directory], or next to the point file if that isn't set) so it never holds more
+          than [sort_memory_mb] megabytes of them.  */
 
-          /*  IMPORTANT NOTE: Since MISP always wants to create a grid that has points at the corners of each cell and we want a grid
-              with points at the center of each cell we're going to cheat a bit more here.  We have told MISP that the grid spacing
-              is 1.0 in both directions (clever, no) so we are going to add .5 to the X and Y positions so that MISP will build a
-              grid with points at the cell centers.  */
+      load.writer = point_file[0] ? pointfile_create (point_file, sort_directory, sort_memory_mb) : NULL;
+      pthread_mutex_init (&load.writer_mutex, NULL);
 
 
-          /* we no longer need the half node shift since we moved chrtr2 to grid registration -SJ */
+      /*  If [prebin] is set the points are binned into the grid cells on the decoder threads and only one point per
+          occupied cell (the mean, or the original point nearest the node if force_original_value is set) is loaded into
+          MISP.  This changes the gridded result: MISP gets no count or weight with the point, so every occupied cell
+          counts the same however many soundings it had, and the distance weighting of the individual points is lost.
+          It's a speed and memory trade, not an equivalent of loading every point.  If [thin_factor] is set the grid
+          cells are split into thin_factor x thin_factor sub-cells instead and [thin_method] picks the point that's
+          loaded for each occupied sub-cell (0 - shoalest, which is the default since this is for nautical charting, 1 -
+          mean, 2 - median).  The binned area is the chart plus the search radius.  The median has to keep every Z (8
+          bytes per point) until the end so it's limited to [sort_memory_mb] megabytes of them (see prebin.c for the
+          rest of the memory this uses).  */
 
-          xyz.x = (xyz.x - in_mbr.wlon) / x_griddeg;  /* + 0.5;*/
-          xyz.y = (xyz.y - in_mbr.slat) / y_griddeg;  /* + 0.5;*/
+      load.prebin = NULL;
+      load.num_cells = 0;
+      ingest_params.thread_load = NULL;
+      ingest_params.thread_done = NULL;
 
+      if (thin_factor < 0)
+        {
+          fprintf (stderr, "\n\n[thin_factor] of %d is negative, thinning is turned off.\n\n", thin_factor);
+          thin_factor = 0;
+        }
 
-          /*  Load data and check for out of area conditions.  */
+      if (thin_factor > PREBIN_MAX_FACTOR)
+        {
+          fprintf (stderr, "\n\n[thin_factor] of %d is too large, using %d.\n\n", thin_factor, PREBIN_MAX_FACTOR);
+          thin_factor = PREBIN_MAX_FACTOR;
+        }
 
-          if (!misp_load (xyz))
+      if (prebin || thin_factor > 0)
+        {
+          if (thin_factor > 0)
             {
-              out_of_area++;
+              switch (thin_method)
+                {
+                case 1:
+                  tmp_i = PREBIN_MEAN;
+                  break;
+
+                case 2:
+                  tmp_i = PREBIN_MEDIAN;
+                  break;
+
+                default:
+                  tmp_i = PREBIN_SHOALEST;
+                  break;
+                }
             }
           else
             {
-              num_points++;
+              thin_factor = 1;
+              tmp_i = force_original_value ? PREBIN_NEAREST : PREBIN_MEAN;
             }
+
+          load.prebin = prebin_init (&in_mbr, x_griddeg, y_griddeg, gridcols, gridrows, (int32_t) ceil (search_radius),
+                                     reader_threads > 0 ? reader_threads : ingest_processors (), thin_factor, tmp_i,
+                                     sort_memory_mb);
+          ingest_params.thread_load = prebin_block;
+          ingest_params.thread_done = prebin_done;
         }
 
 
+      /*  If [sort_directory] is set (and we're not binning) the points are sorted into Morton order of their grid cells
+          before they're loaded into MISP so the loads sweep the grid instead of jumping all over it.  No more than
+          [sort_memory_mb] megabytes of points are held at a time, the rest are written to sorted run files in
+          sort_directory and merged afterwards (see spill.c).  If [point_file] is also set, the point file writer's sort
+          holds its own [sort_memory_mb] at the same time so the two together can use twice that.  */
+
+      load.spill = NULL;
+
+      if (sort_directory[0] && load.prebin == NULL)
+        load.spill = spill_create (sort_directory, sort_memory_mb, &in_mbr, x_griddeg, y_griddeg, gridcols, gridrows,
+                                   (int32_t) ceil (search_radius));
+
+      ingest_params.files = input_filenames;
+      ingest_params.numfiles = numfiles;
+      ingest_params.reader.date_line = dateline;
+      ingest_params.reader.nominal = nominal;
+      ingest_params.reader.fast_geolocation = fast_geolocation;
+
+
+      /*  [las_classes] is a comma or space separated list of the LAS classifications to use (e.g. 2,29,40).  If it's
+          not set we use everything that isn't withheld.  */
+
+      memset (ingest_params.reader.las_skip, las_classes[0] ? 1 : 0, sizeof (ingest_params.reader.las_skip));
+
+      for (token = strtok (las_classes, ", \t") ; token != NULL ; token = strtok (NULL, ", \t"))
+        {
+          tmp_i = atoi (token);
+          if (tmp_i >= 0 && tmp_i < 256) ingest_params.reader.las_skip[tmp_i] = 0;
+        }
+
+
+      /*  GSF pings whose swaths can't reach the area (plus the MISP search radius) are skipped in the reader (as are
+          PFM bins, point file chunks, and whole files whose headers show they're outside of the area).  If we're
+          writing a point file we don't cull anything since the point file may be used to grid a different area later
+          (the points outside of this area are still dropped by MISP).  For the same reason files aren't skipped using
+          their summaries.  */
+
+      ingest_params.reader.cull = (load.writer == NULL);
+      ingest_params.reader.cull_mbr.slat = in_mbr.slat - search_radius * y_griddeg;
+      ingest_params.reader.cull_mbr.nlat = in_mbr.nlat + search_radius * y_griddeg;
+      ingest_params.reader.cull_mbr.wlon = in_mbr.wlon - search_radius * x_griddeg;
+      ingest_params.reader.cull_mbr.elon = in_mbr.elon + search_radius * x_griddeg;
+      ingest_params.summaries = file_summaries && load.writer == NULL;
+      ingest_params.summary_directory = index_directory;
+      ingest_params.num_threads = reader_threads;
+      ingest_params.queue_depth = queue_depth;
+      ingest_params.prefetch_files = prefetch_files;
+
+      if (ingest (&ingest_params, load_block, &load)) exit (-1);
+
+      if (load.prebin != NULL)
+        {
+          prebin_merge (load.prebin);
+          load.out_of_area += prebin_out_of_area (load.prebin);
+          prebin_emit (load.prebin, load_cell, &load);
+          prebin_free (load.prebin);
+        }
+
+      if (load.spill != NULL)
+        {
+          load.out_of_area += spill_out_of_area (load.spill);
+          spill_finish (load.spill, load_point, &load);
+        }
+
+      if (load.writer != NULL)
+        {
+          fprintf (stderr, "\n\nWriting point file %s\n", point_file);
+          fflush (stderr);
+
+          if (pointfile_close (load.writer)) exit (-1);
+        }
+
+      printf ("\n\n\n");
+
+      out_of_area = load.out_of_area;
+      num_points = load.num_points;
+
+      fprintf (stderr, "%" PRId64 " points loaded, %" PRId64 " points outside of the area\n", num_points, out_of_area);
+      if (prebin || thin_factor > 0) fprintf (stderr, "%" PRId64 " binned points loaded into MISP\n", load.num_cells);
+      if (ingest_params.skipped) fprintf (stderr, "%" PRId64 " input files outside of the area skipped\n", ingest_params.skipped);
+      if (ingest_params.culled) fprintf (stderr, "%" PRId64 " GSF pings outside of the area skipped\n", ingest_params.culled);
+      fprintf (stderr, "\n");
+      fflush (stderr);
+
+
       if (num_points == 0)
         {
           fprintf (stderr, "\n\nNo data points within specified bounds.\n");
@@ -393,27 +749,19 @@ int32_t main (int32_t argc, char *argv[])
         }
 
 
+      /*  When nibbling, the surface is kept in memory (see surface.c) until it's been nibbled and is written after
+          that.  Otherwise each row is written as soon as MISP hands it to us.  */
+
       if (nibble)
         {
-          val_array = (uint8_t **) malloc (gridrows * sizeof (uint8_t *));
+          surface = surface_create (gridcols, gridrows);
 
-          if (val_array == NULL)
+          row_flags = (uint8_t *) calloc (gridcols + 1, sizeof (uint8_t));
+          if (row_flags == NULL)
             {
-              perror ("Allocating val_array");
+              perror ("Allocating row_flags");
               exit (-1);
             }
-
-
-          for (i = 0 ; i < gridrows ; i++)
-            {
-              val_array[i] = (uint8_t *) malloc (gridcols * sizeof (uint8_t));
-
-              if (val_array[i] == NULL)
-                {
-                  perror ("Allocating val_array[i]");
-                  exit (-1);
-                }
-            }
         }
 
 
@@ -425,6 +773,17 @@ int32_t main (int32_t argc, char *argv[])
         {
           if (row >= gridrows) break;
 
+          if (nibble)
+            {
+              for (i = 0 ; i < gridcols ; i++) row_flags[i] = bit_test (array[i], 0) ? SURFACE_REAL : 0;
+
+              surface_put_row (surface, row, array, row_flags);
+
+              row++;
+              continue;
+            }
+
+
           for (i = 0 ; i < gridcols ; i++) 
             {
               if (array[i] < chrtr2_header.min_observed_z) chrtr2_header.min_observed_z = array[i];
@@ -438,14 +797,10 @@ int32_t main (int32_t argc, char *argv[])
               if (bit_test (array[i], 0))
                 {
                   chrtr2_array[i].status = CHRTR2_REAL;
-
-                  if (nibble) val_array[row][i] = NVTrue;
                 }
               else
                 {
                   chrtr2_array[i].status = CHRTR2_INTERPOLATED;
-
-                  if (nibble) val_array[row][i] = NVFalse;
                 }
             }
 
@@ -478,59 +833,7 @@ int32_t main (int32_t argc, char *argv[])
           fprintf (stderr, "\n\nNibbling                                                         \n\n");
           fflush (stderr);
 
-
-          percent = 0;
-          old_percent = -1;
-
-          for (i = 0 ; i < gridrows ; i++)
-            {
-              dn = MAX (i - nibble, 0);
-              up = MIN (i + nibble, gridrows - 1);
-
-              for (j = 0 ; j < gridcols ; j++)
-                {
-                  if (!val_array[i][j])
-                    {
-                      bw = MAX (j - nibble, 0);
-                      fw = MIN (j + nibble, gridcols - 1);
-
-                      found = NVFalse;
-                      for (k = dn ; k <= up ; k++)
-                        {
-                          for (m = bw ; m <= fw ; m++)
-                            {
-                              if (val_array[k][m])
-                                {
-                                  found = NVTrue;
-                                  break;
-                                }
-                            }
-                          if (found) break;
-                        }
-
-                      if (!found)
-                        {
-                          chrtr2_read_record_row_col (chrtr2_hnd, i, j, &chrtr2_record);
-
-                          memset (&chrtr2_record, 0, sizeof (CHRTR2_RECORD));
-
-                          chrtr2_write_record_row_col (chrtr2_hnd, i, j, chrtr2_record);
-                        }
-                    }
-                }
-
-              percent = ((float) (i) / (float) gridrows) * 100.0;
-              if (old_percent != percent) 
-                {
-                  fprintf (stderr, "%03d%% nibbled             \r", percent);
-                  fflush (stderr);
-                  old_percent = percent;
-                }
-            }
-
-
-          for (i = 0 ; i < gridrows ; i++) free (val_array[i]);
-          free (val_array);
+          surface_nibble (surface, nibble);
 
 
           percent = 0;
@@ -541,21 +844,38 @@ int32_t main (int32_t argc, char *argv[])
 
           for (i = 0 ; i < gridrows ; i++)
             {
-              chrtr2_read_row (chrtr2_hnd, i, 0, gridcols, chrtr2_array);
+              surface_get_row (surface, i, array, row_flags);
 
 
-              /*  We need to recompute the mins and maxes.  */
+              /*  Only the gridcols - 1 cells that get written count towards the mins and maxes.  */
 
-              for (j = 0 ; j < gridcols ; j++)
+              for (j = 0 ; j < gridcols - 1 ; j++)
                 {
-                  if (chrtr2_array[j].status)
+                  memset (&chrtr2_array[j], 0, sizeof (CHRTR2_RECORD));
+
+                  if (row_flags[j] & SURFACE_KEEP)
                     {
+                      chrtr2_array[j].z = array[j];
+                      chrtr2_array[j].status = (row_flags[j] & SURFACE_REAL) ? CHRTR2_REAL : CHRTR2_INTERPOLATED;
+
+
+                      /*  We need to recompute the mins and maxes.  */
+
                       if (chrtr2_array[j].z < chrtr2_header.min_observed_z) chrtr2_header.min_observed_z = chrtr2_array[j].z;
                       if (chrtr2_array[j].z > chrtr2_header.max_observed_z) chrtr2_header.max_observed_z = chrtr2_array[j].z;
                     }
                 }
 
 
+              /*  Same length as the rows above (see the note there).  */
+
+              if (chrtr2_write_row (chrtr2_hnd, i, 0, gridcols - 1, chrtr2_array))
+                {
+                  chrtr2_perror ();
+                  exit (-1);
+                }
+
+
               percent = ((float) (i) / (float) gridrows) * 100.0;
               if (old_percent != percent) 
                 {
@@ -566,6 +886,8 @@ int32_t main (int32_t argc, char *argv[])
             }
 
 
+          surface_free (surface);
+          free (row_flags);
           free (chrtr2_array);
 
 
@@ -0,0 +1,245 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        mapfile                                             *
+*                                                                           *
+*   Purpose:            Memory map input files and work on whole blocks of  *
+*                       fixed length binary records (DPG and RDP) at once.  *
+*                       The loops over the records are written so that the  *
+*                       compiler can vectorize them.  If SSSE3 is           *
+*                       available at compile time (-mssse3 or               *
+*                       -march=native) the byte swap uses pshufb to swap    *
+*                       four words per instruction.                         *
+*                                                                           *
+\***************************************************************************/
+
+#ifdef NVWIN3X
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "mapfile.h"
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        map_file                                            *
+*                                                                           *
+*   Purpose:            Map an entire file read only.                       *
+*                                                                           *
+*   Inputs:             path        -   file name                           *
+*                       map         -   MAPPED_FILE to fill in              *
+*                                                                           *
+*   Outputs:            int32_t     -   0 on success, -1 on failure (errno  *
+*                                       is set on Linux)                    *
+*                                                                           *
+\***************************************************************************/
+
+int32_t map_file (char *path, MAPPED_FILE *map)
+{
+  memset (map, 0, sizeof (MAPPED_FILE));
+
+#ifdef NVWIN3X
+
+  LARGE_INTEGER        size;
+
+
+  map->file_handle = CreateFile (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                                 NULL);
+  if (map->file_handle == INVALID_HANDLE_VALUE) return (-1);
+
+  if (!GetFileSizeEx (map->file_handle, &size))
+    {
+      CloseHandle (map->file_handle);
+      return (-1);
+    }
+
+  map->size = size.QuadPart;
+
+
+  /*  You can't map an empty file on Windows.  */
+
+  if (!map->size) return (0);
+
+  map->map_handle = CreateFileMapping (map->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (map->map_handle == NULL)
+    {
+      CloseHandle (map->file_handle);
+      return (-1);
+    }
+
+  map->data = (uint8_t *) MapViewOfFile (map->map_handle, FILE_MAP_READ, 0, 0, 0);
+  if (map->data == NULL)
+    {
+      CloseHandle (map->map_handle);
+      CloseHandle (map->file_handle);
+      return (-1);
+    }
+
+#else
+
+  int32_t              fd;
+  struct stat          st;
+  void                 *addr;
+
+
+  if ((fd = open (path, O_RDONLY)) < 0) return (-1);
+
+  if (fstat (fd, &st) < 0)
+    {
+      close (fd);
+      return (-1);
+    }
+
+  map->size = st.st_size;
+
+  if (map->size)
+    {
+      addr = mmap (NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (addr == MAP_FAILED)
+        {
+          close (fd);
+          return (-1);
+        }
+
+      map->data = (uint8_t *) addr;
+
+
+      /*  We're going to read it front to back so let the kernel read ahead aggressively.  */
+
+      madvise (addr, map->size, MADV_SEQUENTIAL);
+    }
+
+
+  /*  The mapping stays valid after the descriptor is closed.  */
+
+  close (fd);
+
+#endif
+
+  return (0);
+}
+
+
+
+void unmap_file (MAPPED_FILE *map)
+{
+#ifdef NVWIN3X
+  if (map->data != NULL) UnmapViewOfFile (map->data);
+  if (map->map_handle != NULL) CloseHandle (map->map_handle);
+  if (map->file_handle != NULL && map->file_handle != INVALID_HANDLE_VALUE) CloseHandle (map->file_handle);
+#else
+  if (map->data != NULL) munmap (map->data, map->size);
+#endif
+
+  memset (map, 0, sizeof (MAPPED_FILE));
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        swap_words                                          *
+*                                                                           *
+*   Purpose:            Byte swap an array of 32 bit words.  The source and *
+*                       destination may be the same.                        *
+*                                                                           *
+\***************************************************************************/
+
+void swap_words (uint32_t *dst, const uint32_t *src, int64_t count)
+{
+  int64_t              i = 0;
+
+
+#ifdef __SSSE3__
+
+  __m128i              shuffle, words;
+
+
+  shuffle = _mm_set_epi8 (12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+  for ( ; i + 4 <= count ; i += 4)
+    {
+      words = _mm_loadu_si128 ((const __m128i *) &src[i]);
+      _mm_storeu_si128 ((__m128i *) &dst[i], _mm_shuffle_epi8 (words, shuffle));
+    }
+
+#endif
+
+
+  for ( ; i < count ; i++)
+    {
+      dst[i] = ((src[i] & 0x000000ff) << 24) | ((src[i] & 0x0000ff00) << 8) | ((src[i] & 0x00ff0000) >> 8) |
+        ((src[i] & 0xff000000) >> 24);
+    }
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        nonzero_records                                     *
+*                                                                           *
+*   Purpose:            Flag the three word records that are not all zero.  *
+*                       DPG and RDP files use an all zero record as a       *
+*                       terminator/filler so these get dropped.             *
+*                                                                           *
+*   Inputs:             words       -   num_records * 3 words (already in   *
+*                                       native byte order)                  *
+*                       num_records -   number of records                   *
+*                       word_mask   -   mask applied to each word before    *
+*                                       the test.  Use 0x7fffffff for       *
+*                                       floats so that -0.0 counts as zero  *
+*                                       like it did with the float compare. *
+*                       valid       -   1 if the record is not all zero,    *
+*                                       otherwise 0                         *
+*                                                                           *
+*   Outputs:            int64_t     -   number of valid records             *
+*                                                                           *
+\***************************************************************************/
+
+int64_t nonzero_records (const uint32_t *words, int64_t num_records, uint32_t word_mask, uint8_t *valid)
+{
+  int64_t              i, count = 0;
+
+
+  for (i = 0 ; i < num_records ; i++)
+    {
+      valid[i] = (((words[i * 3] | words[i * 3 + 1] | words[i * 3 + 2]) & word_mask) != 0);
+      count += valid[i];
+    }
+
+  return (count);
+}
@@ -0,0 +1,60 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+#ifndef __CHRTR2_MAPFILE_H__
+#define __CHRTR2_MAPFILE_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+
+
+/*  Read only memory mapped file.  */
+
+typedef struct
+{
+  uint8_t       *data;                      /*  Start of the mapped file  */
+  int64_t       size;                       /*  Size of the file in bytes  */
+#ifdef NVWIN3X
+  void          *file_handle;
+  void          *map_handle;
+#endif
+} MAPPED_FILE;
+
+
+int32_t map_file (char *path, MAPPED_FILE *map);
+void unmap_file (MAPPED_FILE *map);
+
+void swap_words (uint32_t *dst, const uint32_t *src, int64_t count);
+int64_t nonzero_records (const uint32_t *words, int64_t num_records, uint32_t word_mask, uint8_t *valid);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        morton                                              *
+*                                                                           *
+*   Purpose:            Morton (Z-order) keys and a radix sort for them.    *
+*                       Points sorted on their keys are close together in   *
+*                       both X and Y.  Used by the point file writer and    *
+*                       the spill sort (see pointfile.c and spill.c).       *
+*                                                                           *
+\***************************************************************************/
+
+#include "morton.h"
+
+
+/*  Spread the bits of a 32 bit value out to the even bits of a 64 bit value.  */
+
+static uint64_t spread_bits (uint64_t v)
+{
+  v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+  v = (v | (v << 8)) & 0x00ff00ff00ff00ffULL;
+  v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  v = (v | (v << 2)) & 0x3333333333333333ULL;
+  v = (v | (v << 1)) & 0x5555555555555555ULL;
+
+  return (v);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        morton_key                                          *
+*                                                                           *
+*   Purpose:            Interleave the bits of x and y (x in the even       *
+*                       bits).                                              *
+*                                                                           *
+\***************************************************************************/
+
+uint64_t morton_key (uint32_t x, uint32_t y)
+{
+  return (spread_bits (x) | (spread_bits (y) << 1));
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        morton_sort                                         *
+*                                                                           *
+*   Purpose:            LSD radix sort of the Morton keys, a byte at a      *
+*                       time.  Passes where every key has the same byte are *
+*                       skipped.  The sorted keys end up back in keys.      *
+*                                                                           *
+\***************************************************************************/
+
+void morton_sort (MORTON_KEY *keys, int64_t count)
+{
+  MORTON_KEY           *tmp, *src, *dst, *swap;
+  int64_t              histogram[256], i, sum, n;
+  int32_t              pass, shift;
+
+
+  if (count < 2) return;
+
+  tmp = (MORTON_KEY *) malloc (count * sizeof (MORTON_KEY));
+  if (tmp == NULL)
+    {
+      perror ("Allocating Morton sort buffer");
+      exit (-1);
+    }
+
+  src = keys;
+  dst = tmp;
+
+  for (pass = 0 ; pass < 8 ; pass++)
+    {
+      shift = pass * 8;
+
+      memset (histogram, 0, sizeof (histogram));
+      for (i = 0 ; i < count ; i++) histogram[(src[i].key >> shift) & 0xff]++;
+
+      if (histogram[(src[0].key >> shift) & 0xff] == count) continue;
+
+      for (i = 0, sum = 0 ; i < 256 ; i++)
+        {
+          n = histogram[i];
+          histogram[i] = sum;
+          sum += n;
+        }
+
+      for (i = 0 ; i < count ; i++) dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+
+      swap = src;
+      src = dst;
+      dst = swap;
+    }
+
+  if (src != keys) memcpy (keys, src, count * sizeof (MORTON_KEY));
+
+  free (tmp);
+}
@@ -0,0 +1,413 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        pointfile                                           *
+*                                                                           *
+*   Purpose:            Write and decode chrtr2 point files (see            *
+*                       pointfile.h).  The writer hands the points it's     *
+*                       given to a geographic spill sort (see spill.c) so   *
+*                       no more than memory_mb megabytes of them are held   *
+*                       at a time.  At pointfile_close the sorted runs are  *
+*                       merged along a Morton curve straight into           *
+*                       POINTFILE_CHUNK_POINTS point chunks.  The reader    *
+*                       side (in reader.c) maps the file and uses           *
+*                       pointfile_check and pointfile_decode.               *
+*                                                                           *
+\***************************************************************************/
+
+#include <libgen.h>
+#include <unistd.h>
+
+#include "pointfile.h"
+#include "spill.h"
+
+
+struct POINTFILE_WRITER
+{
+  char                 *file;
+  SPILL                *spill;
+  POINTFILE_HEADER     head;                /*  Bounds and point count are kept up to date by pointfile_add  */
+  FILE                 *fp;                 /*  Output file while pointfile_close is writing chunks  */
+  POINTFILE_CHUNK      *index;
+  uint32_t             *col_x;
+  uint32_t             *col_y;
+  float                *col_z;
+  int32_t              n;                   /*  Points in the chunk being filled  */
+  uint64_t             chunk;               /*  Chunk being filled  */
+};
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        pointfile_create                                    *
+*                                                                           *
+*   Purpose:            Start a new point file.  Nothing is written to the  *
+*                       file until pointfile_close.                         *
+*                                                                           *
+*   Inputs:             file        -   point file name                     *
+*                       directory   -   where to put the sort's run files   *
+*                                       (the point file's directory if      *
+*                                       empty)                              *
+*                       memory_mb   -   memory for points that haven't      *
+*                                       been written to a run file yet      *
+*                                                                           *
+\***************************************************************************/
+
+POINTFILE_WRITER *pointfile_create (char *file, char *directory, int32_t memory_mb)
+{
+  POINTFILE_WRITER     *writer;
+  char                 dir[2048];
+
+
+  writer = (POINTFILE_WRITER *) calloc (1, sizeof (POINTFILE_WRITER));
+  if (writer == NULL)
+    {
+      perror ("Allocating point file writer");
+      exit (-1);
+    }
+
+  writer->file = strdup (file);
+
+
+  /*  dirname may modify its argument and may return a pointer into it or a static string.  */
+
+  if (directory[0])
+    {
+      snprintf (dir, sizeof (dir), "%s", directory);
+    }
+  else
+    {
+      snprintf (dir, sizeof (dir), "%s", file);
+      snprintf (dir, sizeof (dir), "%s", dirname (dir));
+    }
+
+  writer->spill = spill_create_geographic (dir, memory_mb);
+
+  strcpy (writer->head.magic, POINTFILE_MAGIC);
+  writer->head.version = POINTFILE_VERSION;
+  writer->head.endian = 0x00010203;
+  writer->head.xy_scale = POINTFILE_XY_SCALE;
+
+  return (writer);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        pointfile_add                                       *
+*                                                                           *
+*   Purpose:            Add a block of points to the point file.            *
+*                                                                           *
+\***************************************************************************/
+
+void pointfile_add (POINTFILE_WRITER *writer, READER_BLOCK *block)
+{
+  POINTFILE_HEADER     *head = &writer->head;
+  double               x;
+  int32_t              i;
+
+
+  /*  Longitudes are kept in -180 to 180 so the file doesn't depend on whether this chart crossed the date line (the
+      spill sort does the same).  */
+
+  for (i = 0 ; i < block->count ; i++)
+    {
+      x = block->x[i] > 180.0 ? block->x[i] - 360.0 : block->x[i];
+
+      if (!head->num_points && !i)
+        {
+          head->min_x = head->max_x = x;
+          head->min_y = head->max_y = block->y[i];
+          head->min_z = head->max_z = block->z[i];
+        }
+
+      head->min_x = MIN (head->min_x, x);
+      head->max_x = MAX (head->max_x, x);
+      head->min_y = MIN (head->min_y, block->y[i]);
+      head->max_y = MAX (head->max_y, block->y[i]);
+      head->min_z = MIN (head->min_z, block->z[i]);
+      head->max_z = MAX (head->max_z, block->z[i]);
+    }
+
+  head->num_points += block->count;
+
+  spill_add (writer->spill, block);
+}
+
+
+
+/*  Write the chunk that's being filled (writer->n points).  Its index entry bounds were set by put_point.  */
+
+static void flush_chunk (POINTFILE_WRITER *writer)
+{
+  if (!writer->n) return;
+
+  writer->index[writer->chunk].offset = ftello (writer->fp);
+  writer->index[writer->chunk].count = writer->n;
+
+  fwrite (writer->col_x, sizeof (uint32_t), writer->n, writer->fp);
+  fwrite (writer->col_y, sizeof (uint32_t), writer->n, writer->fp);
+  fwrite (writer->col_z, sizeof (float), writer->n, writer->fp);
+
+  writer->chunk++;
+  writer->n = 0;
+}
+
+
+
+/*  SPILL_EMIT function for pointfile_close.  The points come in sorted order and go into the chunk being filled.  If
+    the output file couldn't be opened they're thrown away (spill_finish still removes the run files).  */
+
+static void put_point (NV_F64_COORD3 xyz, void *user_data)
+{
+  POINTFILE_WRITER     *writer = (POINTFILE_WRITER *) user_data;
+  POINTFILE_CHUNK      *chunk;
+
+
+  if (writer->fp == NULL) return;
+
+  chunk = &writer->index[writer->chunk];
+
+  if (!writer->n)
+    {
+      chunk->min_x = chunk->max_x = xyz.x;
+      chunk->min_y = chunk->max_y = xyz.y;
+    }
+
+  chunk->min_x = MIN (chunk->min_x, xyz.x);
+  chunk->max_x = MAX (chunk->max_x, xyz.x);
+  chunk->min_y = MIN (chunk->min_y, xyz.y);
+  chunk->max_y = MAX (chunk->max_y, xyz.y);
+
+  writer->col_x[writer->n] = (uint32_t) ((xyz.x - writer->head.x_offset) / writer->head.xy_scale + 0.5);
+  writer->col_y[writer->n] = (uint32_t) ((xyz.y - writer->head.y_offset) / writer->head.xy_scale + 0.5);
+  writer->col_z[writer->n] = xyz.z;
+
+  if (++writer->n == POINTFILE_CHUNK_POINTS) flush_chunk (writer);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        pointfile_close                                     *
+*                                                                           *
+*   Purpose:            Merge the sorted points into the point file and     *
+*                       free the writer.  The file is written under a       *
+*                       temporary name and renamed when it's complete.      *
+*                                                                           *
+*   Outputs:            int32_t     -   0 on success, -1 on failure         *
+*                                                                           *
+\***************************************************************************/
+
+int32_t pointfile_close (POINTFILE_WRITER *writer)
+{
+  POINTFILE_HEADER     *head = &writer->head;
+  char                 tmp_path[2100], pad[8] = {0};
+  int32_t              status = 0;
+
+
+  head->num_chunks = (head->num_points + POINTFILE_CHUNK_POINTS - 1) / POINTFILE_CHUNK_POINTS;
+  head->x_offset = head->min_x;
+  head->y_offset = head->min_y;
+
+  writer->index = (POINTFILE_CHUNK *) calloc (MAX (head->num_chunks, 1), sizeof (POINTFILE_CHUNK));
+  writer->col_x = (uint32_t *) malloc (POINTFILE_CHUNK_POINTS * sizeof (uint32_t));
+  writer->col_y = (uint32_t *) malloc (POINTFILE_CHUNK_POINTS * sizeof (uint32_t));
+  writer->col_z = (float *) malloc (POINTFILE_CHUNK_POINTS * sizeof (float));
+
+  if (writer->index == NULL || writer->col_x == NULL || writer->col_y == NULL || writer->col_z == NULL)
+    {
+      perror ("Allocating point file buffers");
+      exit (-1);
+    }
+
+
+  snprintf (tmp_path, sizeof (tmp_path), "%s.%d", writer->file, (int32_t) getpid ());
+
+  if ((writer->fp = fopen (tmp_path, "wb")) == NULL)
+    {
+      perror (tmp_path);
+      status = -1;
+    }
+  else
+    {
+      fwrite (head, sizeof (POINTFILE_HEADER), 1, writer->fp);
+    }
+
+
+  /*  The chunks are written as the points come out of the spill sort.  */
+
+  spill_finish (writer->spill, put_point, writer);
+
+  if (writer->fp != NULL)
+    {
+      flush_chunk (writer);
+
+
+      /*  Keep the index doubles aligned when the file is mapped.  */
+
+      head->index_offset = ftello (writer->fp);
+      if (head->index_offset % 8)
+        {
+          fwrite (pad, 1, 8 - head->index_offset % 8, writer->fp);
+          head->index_offset = ftello (writer->fp);
+        }
+
+      fwrite (writer->index, sizeof (POINTFILE_CHUNK), head->num_chunks, writer->fp);
+
+      fseeko (writer->fp, 0, SEEK_SET);
+      fwrite (head, sizeof (POINTFILE_HEADER), 1, writer->fp);
+
+      if (ferror (writer->fp))
+        {
+          perror (tmp_path);
+          status = -1;
+        }
+
+      if (fclose (writer->fp)) status = -1;
+
+      if (status || rename (tmp_path, writer->file))
+        {
+          perror (writer->file);
+          remove (tmp_path);
+          status = -1;
+        }
+    }
+
+  free (writer->index);
+  free (writer->col_x);
+  free (writer->col_y);
+  free (writer->col_z);
+  free (writer->file);
+  free (writer);
+
+  return (status);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        pointfile_check                                     *
+*                                                                           *
+*   Purpose:            Make sure a point file header, the chunk index, and *
+*                       the chunks fit in a (mapped) file of size bytes.    *
+*                                                                           *
+*   Inputs:             head        -   start of the file                   *
+*                       size        -   size of the file                    *
+*                       file        -   file name (for error messages)      *
+*                                                                           *
+*   Outputs:            uint8_t     -   NVTrue if the file is usable        *
+*                                                                           *
+\***************************************************************************/
+
+uint8_t pointfile_check (POINTFILE_HEADER *head, int64_t size, char *file)
+{
+  POINTFILE_CHUNK      *chunks;
+  uint64_t             i;
+
+
+  if (size < (int64_t) sizeof (POINTFILE_HEADER) || strcmp (head->magic, POINTFILE_MAGIC))
+    {
+      fprintf (stderr, "\n\nFile %s is not a chrtr2 point file\n", file);
+      fflush (stderr);
+      return (NVFalse);
+    }
+
+  if (head->endian != 0x00010203 || head->version != POINTFILE_VERSION)
+    {
+      fprintf (stderr, "\n\nPoint file %s is from a different version of chrtr2 or has a different byte order\n", file);
+      fflush (stderr);
+      return (NVFalse);
+    }
+
+  if (head->index_offset > (uint64_t) size ||
+      head->num_chunks > ((uint64_t) size - head->index_offset) / sizeof (POINTFILE_CHUNK))
+    {
+      fprintf (stderr, "\n\nPoint file %s is truncated\n", file);
+      fflush (stderr);
+      return (NVFalse);
+    }
+
+  chunks = (POINTFILE_CHUNK *) ((uint8_t *) head + head->index_offset);
+
+  for (i = 0 ; i < head->num_chunks ; i++)
+    {
+      if (chunks[i].offset > head->index_offset ||
+          chunks[i].count > (head->index_offset - chunks[i].offset) / (2 * sizeof (uint32_t) + sizeof (float)))
+        {
+          fprintf (stderr, "\n\nPoint file %s has a bad chunk index\n", file);
+          fflush (stderr);
+          return (NVFalse);
+        }
+    }
+
+  return (NVTrue);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        pointfile_decode                                    *
+*                                                                           *
+*   Purpose:            Convert count points of a chunk, starting at point  *
+*                       start, to degrees.                                  *
+*                                                                           *
+*   Inputs:             head        -   point file header                   *
+*                       chunk       -   chunk index entry                   *
+*                       data        -   start of the file                   *
+*                       start       -   first point in the chunk            *
+*                       count       -   number of points                    *
+*                       x, y, z     -   output (room for count points)      *
+*                                                                           *
+*   Outputs:            int64_t     -   number of points                    *
+*                                                                           *
+\***************************************************************************/
+
+int64_t pointfile_decode (POINTFILE_HEADER *head, POINTFILE_CHUNK *chunk, const uint8_t *data, int64_t start,
+                          int64_t count, double *x, double *y, double *z)
+{
+  const uint32_t       *col_x, *col_y;
+  const float          *col_z;
+  int64_t              i;
+
+
+  col_x = (const uint32_t *) (data + chunk->offset) + start;
+  col_y = (const uint32_t *) (data + chunk->offset) + chunk->count + start;
+  col_z = (const float *) ((const uint32_t *) (data + chunk->offset) + 2 * chunk->count) + start;
+
+  for (i = 0 ; i < count ; i++)
+    {
+      x[i] = head->x_offset + col_x[i] * head->xy_scale;
+      y[i] = head->y_offset + col_y[i] * head->xy_scale;
+      z[i] = col_z[i];
+    }
+
+  return (count);
+}
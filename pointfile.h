@@ -0,0 +1,105 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+
+#ifndef __CHRTR2_POINTFILE_H__
+#define __CHRTR2_POINTFILE_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+#include "reader.h"
+
+
+/*  Point files (.ch2p) hold the points that the readers delivered on an earlier run so that the same data can be
+    gridded again (at a different resolution or for a different area) without decoding the original files.  The layout
+    is:
+
+        POINTFILE_HEADER
+        chunk 0: uint32_t x[count], uint32_t y[count], float z[count]
+        chunk 1: ...
+        POINTFILE_CHUNK index[num_chunks]          (at index_offset)
+
+    The points are sorted along a Morton (Z order) curve over the whole globe before they're cut into chunks so each
+    chunk covers a small area and the reader can skip every chunk whose bounds miss the chart.  X and Y are scaled
+    unsigned integers (x_offset + x * xy_scale degrees), Z is a float.  Everything is in the byte order of the system
+    that wrote the file.  */
+
+#define         POINTFILE_EXTENSION     ".ch2p"
+#define         POINTFILE_MAGIC         "CH2PNTS"
+#define         POINTFILE_VERSION       1
+#define         POINTFILE_CHUNK_POINTS  65536
+#define         POINTFILE_XY_SCALE      1.0e-7          /*  About a centimeter  */
+
+
+typedef struct
+{
+  char          magic[8];
+  uint32_t      version;
+  uint32_t      endian;                     /*  0x00010203 as written  */
+  uint64_t      num_points;
+  uint64_t      num_chunks;
+  uint64_t      index_offset;               /*  Byte offset of the chunk index  */
+  double        xy_scale;
+  double        x_offset;
+  double        y_offset;
+  double        min_x;                      /*  Bounds of all of the points (longitudes are -180 to 180)  */
+  double        max_x;
+  double        min_y;
+  double        max_y;
+  double        min_z;
+  double        max_z;
+} POINTFILE_HEADER;
+
+
+typedef struct
+{
+  double        min_x;
+  double        max_x;
+  double        min_y;
+  double        max_y;
+  uint64_t      offset;                     /*  Byte offset of the chunk's x column  */
+  uint64_t      count;
+} POINTFILE_CHUNK;
+
+
+typedef struct POINTFILE_WRITER POINTFILE_WRITER;
+
+
+POINTFILE_WRITER *pointfile_create (char *file, char *directory, int32_t memory_mb);
+void pointfile_add (POINTFILE_WRITER *writer, READER_BLOCK *block);
+int32_t pointfile_close (POINTFILE_WRITER *writer);
+uint8_t pointfile_check (POINTFILE_HEADER *head, int64_t size, char *file);
+int64_t pointfile_decode (POINTFILE_HEADER *head, POINTFILE_CHUNK *chunk, const uint8_t *data, int64_t start,
+                          int64_t count, double *x, double *y, double *z);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
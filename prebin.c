@@ -0,0 +1,712 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        prebin                                              *
+*                                                                           *
+*   Purpose:            Bin the input points into cells on the decoder      *
+*                       threads so that MISP only has to load one point per *
+*                       occupied cell instead of every point (misp_load can *
+*                       only be called from one thread).  The cells are the *
+*                       chart's grid cells divided into factor x factor     *
+*                       sub-cells (factor is 1 for [prebin] and             *
+*                       [thin_factor] when thinning).  Each decoder thread  *
+*                       bins into its own tiles of cell accumulators (so    *
+*                       there's no locking while binning) and folds them    *
+*                       into one shared set of tiles (see prebin_flush)     *
+*                       each time it finishes a file or part of a file, or  *
+*                       sooner if it has PREBIN_THREAD_TILES of them.       *
+*                       After all of the input has been read whatever is    *
+*                       left is merged in parallel and each occupied cell   *
+*                       is handed to prebin_emit's callback as one point    *
+*                       picked by method:                                   *
+*                                                                           *
+*                       PREBIN_MEAN     -   mean position and Z             *
+*                       PREBIN_NEAREST  -   the original point closest to   *
+*                                           the center of the cell (i.e.    *
+*                                           the node when factor is 1)      *
+*                       PREBIN_SHOALEST -   the original point with the     *
+*                                           smallest Z (Z is positive down) *
+*                       PREBIN_MEDIAN   -   mean position and the median Z. *
+*                                           With an even number of points   *
+*                                           the shoaler of the two middle   *
+*                                           values is used.                 *
+*                                                                           *
+*                       Positions are in the grid domain used by main (0.0  *
+*                       to gridcols and 0.0 to gridrows with the nodes at   *
+*                       whole numbers).  The binned area is grown by margin *
+*                       grid cells on every side so the points that MISP    *
+*                       uses from just outside of the chart are kept.       *
+*                                                                           *
+*                       Peak memory is the shared tiles (48 bytes per cell, *
+*                       allocated 64 x 64 cells at a time where there's     *
+*                       data), up to PREBIN_THREAD_TILES tiles (48MB) per   *
+*                       decoder thread, and a tile pointer (8 bytes) per    *
+*                       64 x 64 cells per thread.  PREBIN_MEDIAN also keeps *
+*                       every Z (8 bytes per point) until the merge, and    *
+*                       more than memory_mb megabytes of them is an error.  *
+*                                                                           *
+\***************************************************************************/
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "prebin.h"
+
+
+/*  Number of locks for the shared tiles (a tile uses lock tile % PREBIN_LOCKS).  */
+
+#define PREBIN_LOCKS    64
+
+
+/*  One cell.  Positions are stored as offsets from the cell's center (in grid units) so floats are plenty.  */
+
+typedef struct
+{
+  double               sum_z;
+  double               best_z;              /*  Z of the point picked by PREBIN_NEAREST or PREBIN_SHOALEST  */
+  double               best_key;            /*  Squared distance from the center or Z of the picked point  */
+  float                sum_dx;
+  float                sum_dy;
+  float                best_dx;
+  float                best_dy;
+  uint32_t             count;
+} PREBIN_CELL;
+
+
+/*  For PREBIN_MEDIAN every Z has to be kept until the tile has been merged.  Each thread appends its points to a list
+    for the tile (the cell in the tile and the Z).  */
+
+typedef struct
+{
+  uint16_t             cell;
+  float                z;
+} PREBIN_VALUE;
+
+
+typedef struct
+{
+  PREBIN_VALUE         *value;
+  size_t               count;
+  size_t               size;
+} PREBIN_VALUES;
+
+
+struct PREBIN
+{
+  NV_F64_MBR           mbr;
+  double               x_griddeg;
+  double               y_griddeg;
+  int32_t              margin;
+  int32_t              factor;              /*  Cells per grid cell in each direction  */
+  int32_t              method;
+  int64_t              cols;                /*  Cells, including the margins  */
+  int64_t              rows;
+  int64_t              tiles_x;
+  int64_t              tiles_y;
+  size_t               num_tiles;
+  int32_t              max_threads;
+  PREBIN_CELL          ***tiles;            /*  [thread][tile], NULL until used  */
+  PREBIN_VALUES        **values;            /*  [thread][tile], PREBIN_MEDIAN only  */
+  size_t               **used;              /*  [thread][PREBIN_THREAD_TILES], the tiles each thread has  */
+  int32_t              *num_used;           /*  [thread]  */
+  PREBIN_CELL          **shared;            /*  [tile], NULL until used  */
+  PREBIN_VALUES        *shared_values;      /*  [tile], PREBIN_MEDIAN only  */
+  pthread_mutex_t      locks[PREBIN_LOCKS];
+  int64_t              *out_of_area;        /*  [thread]  */
+  int64_t              max_values;          /*  Most Z values PREBIN_MEDIAN may keep  */
+  atomic_llong         num_values;
+  atomic_llong         next_tile;           /*  Used by the merge threads  */
+};
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        prebin_init                                         *
+*                                                                           *
+*   Purpose:            Set up the cell accumulators.                       *
+*                                                                           *
+*   Inputs:             mbr         -   chart bounds in degrees             *
+*                       x_griddeg   -   grid cell width in degrees          *
+*                       y_griddeg   -   grid cell height in degrees         *
+*                       gridcols    -   grid width                          *
+*                       gridrows    -   grid height                         *
+*                       margin      -   extra grid cells on each side       *
+*                       max_threads -   highest decoder thread number + 1   *
+*                       factor      -   cells per grid cell in each         *
+*                                       direction                           *
+*                       method      -   PREBIN_MEAN, PREBIN_NEAREST,        *
+*                                       PREBIN_SHOALEST, or PREBIN_MEDIAN   *
+*                       memory_mb   -   memory for the Z values that        *
+*                                       PREBIN_MEDIAN keeps                 *
+*                                                                           *
+*   Outputs:            PREBIN *    -   the accumulators                    *
+*                                                                           *
+\***************************************************************************/
+
+PREBIN *prebin_init (NV_F64_MBR *mbr, double x_griddeg, double y_griddeg, int32_t gridcols, int32_t gridrows,
+                     int32_t margin, int32_t max_threads, int32_t factor, int32_t method, int32_t memory_mb)
+{
+  PREBIN               *prebin;
+  int32_t              i;
+
+
+  prebin = (PREBIN *) calloc (1, sizeof (PREBIN));
+  if (prebin == NULL)
+    {
+      perror ("Allocating prebin");
+      exit (-1);
+    }
+
+  if (factor < 1) factor = 1;
+
+  prebin->mbr = *mbr;
+  prebin->x_griddeg = x_griddeg;
+  prebin->y_griddeg = y_griddeg;
+  prebin->margin = margin;
+  prebin->factor = factor;
+  prebin->method = method;
+  prebin->cols = ((int64_t) gridcols + 1 + 2 * margin) * factor;
+  prebin->rows = ((int64_t) gridrows + 1 + 2 * margin) * factor;
+  prebin->tiles_x = (prebin->cols + PREBIN_TILE - 1) / PREBIN_TILE;
+  prebin->tiles_y = (prebin->rows + PREBIN_TILE - 1) / PREBIN_TILE;
+  prebin->num_tiles = (size_t) prebin->tiles_x * (size_t) prebin->tiles_y;
+  prebin->max_threads = max_threads;
+  prebin->max_values = (int64_t) memory_mb * 1048576 / sizeof (PREBIN_VALUE);
+  atomic_init (&prebin->num_values, 0);
+
+  for (i = 0 ; i < PREBIN_LOCKS ; i++) pthread_mutex_init (&prebin->locks[i], NULL);
+
+  prebin->tiles = (PREBIN_CELL ***) calloc (max_threads, sizeof (PREBIN_CELL **));
+  prebin->values = (PREBIN_VALUES **) calloc (max_threads, sizeof (PREBIN_VALUES *));
+  prebin->used = (size_t **) calloc (max_threads, sizeof (size_t *));
+  prebin->num_used = (int32_t *) calloc (max_threads, sizeof (int32_t));
+  prebin->shared = (PREBIN_CELL **) calloc (prebin->num_tiles, sizeof (PREBIN_CELL *));
+  prebin->out_of_area = (int64_t *) calloc (max_threads, sizeof (int64_t));
+
+  if (prebin->tiles == NULL || prebin->values == NULL || prebin->used == NULL || prebin->num_used == NULL ||
+      prebin->shared == NULL || prebin->out_of_area == NULL)
+    {
+      perror ("Allocating prebin tiles");
+      exit (-1);
+    }
+
+  if (method == PREBIN_MEDIAN)
+    {
+      prebin->shared_values = (PREBIN_VALUES *) calloc (prebin->num_tiles,
+                                                         sizeof (PREBIN_VALUES));
+      if (prebin->shared_values == NULL)
+        {
+          perror ("Allocating prebin values");
+          exit (-1);
+        }
+    }
+
+  for (i = 0 ; i < max_threads ; i++)
+    {
+      prebin->tiles[i] = (PREBIN_CELL **) calloc (prebin->num_tiles, sizeof (PREBIN_CELL *));
+      prebin->used[i] = (size_t *) malloc (PREBIN_THREAD_TILES * sizeof (size_t));
+      if (prebin->tiles[i] == NULL || prebin->used[i] == NULL)
+        {
+          perror ("Allocating prebin tiles");
+          exit (-1);
+        }
+
+      if (method == PREBIN_MEDIAN)
+        {
+          prebin->values[i] = (PREBIN_VALUES *) calloc (prebin->num_tiles,
+                                                         sizeof (PREBIN_VALUES));
+          if (prebin->values[i] == NULL)
+            {
+              perror ("Allocating prebin values");
+              exit (-1);
+            }
+        }
+    }
+
+  return (prebin);
+}
+
+
+
+/*  Append count values to a tile's list.  */
+
+static void add_values (PREBIN_VALUES *values, PREBIN_VALUE *value, size_t count)
+{
+  if (values->count + count > values->size)
+    {
+      values->size = MAX (values->size * 2, values->count + count);
+      if (values->size < 1024) values->size = 1024;
+
+      values->value = (PREBIN_VALUE *) realloc (values->value, values->size * sizeof (PREBIN_VALUE));
+      if (values->value == NULL)
+        {
+          perror ("Allocating prebin values");
+          exit (-1);
+        }
+    }
+
+  memcpy (&values->value[values->count], value, count * sizeof (PREBIN_VALUE));
+  values->count += count;
+}
+
+
+
+/*  Fold a thread's copy of a tile into the shared set.  The caller has to hold the tile's lock unless the decoder
+    threads are done.  */
+
+static void fold_tile (PREBIN *prebin, int32_t thread, size_t tile)
+{
+  PREBIN_CELL          *dst, *src;
+  int32_t              i;
+
+
+  if ((src = prebin->tiles[thread][tile]) == NULL) return;
+
+  if ((dst = prebin->shared[tile]) == NULL)
+    {
+      prebin->shared[tile] = src;
+    }
+  else
+    {
+      for (i = 0 ; i < PREBIN_TILE * PREBIN_TILE ; i++)
+        {
+          if (!src[i].count) continue;
+
+          if (!dst[i].count || src[i].best_key < dst[i].best_key)
+            {
+              dst[i].best_key = src[i].best_key;
+              dst[i].best_dx = src[i].best_dx;
+              dst[i].best_dy = src[i].best_dy;
+              dst[i].best_z = src[i].best_z;
+            }
+
+          dst[i].sum_dx += src[i].sum_dx;
+          dst[i].sum_dy += src[i].sum_dy;
+          dst[i].sum_z += src[i].sum_z;
+          dst[i].count += src[i].count;
+        }
+
+      free (src);
+    }
+
+  prebin->tiles[thread][tile] = NULL;
+
+  if (prebin->method == PREBIN_MEDIAN)
+    {
+      add_values (&prebin->shared_values[tile], prebin->values[thread][tile].value, prebin->values[thread][tile].count);
+      free (prebin->values[thread][tile].value);
+      memset (&prebin->values[thread][tile], 0, sizeof (PREBIN_VALUES));
+    }
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        prebin_flush                                        *
+*                                                                           *
+*   Purpose:            Fold a decoder thread's tiles into the shared set   *
+*                       so it doesn't keep a copy of every tile it has      *
+*                       touched.  Only that thread may use its thread       *
+*                       number.  ingest calls this (through main) each time *
+*                       a thread finishes a file or part of a file.         *
+*                                                                           *
+\***************************************************************************/
+
+void prebin_flush (PREBIN *prebin, int32_t thread)
+{
+  size_t               tile;
+  int32_t              i;
+
+
+  for (i = 0 ; i < prebin->num_used[thread] ; i++)
+    {
+      tile = prebin->used[thread][i];
+
+      pthread_mutex_lock (&prebin->locks[tile % PREBIN_LOCKS]);
+      fold_tile (prebin, thread, tile);
+      pthread_mutex_unlock (&prebin->locks[tile % PREBIN_LOCKS]);
+    }
+
+  prebin->num_used[thread] = 0;
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        prebin_add                                          *
+*                                                                           *
+*   Purpose:            Bin a block of points (in degrees) into a decoder   *
+*                       thread's cells.  Only that thread may use its       *
+*                       thread number.                                      *
+*                                                                           *
+\***************************************************************************/
+
+void prebin_add (PREBIN *prebin, int32_t thread, READER_BLOCK *block)
+{
+  PREBIN_CELL          **tiles = prebin->tiles[thread], *cell;
+  PREBIN_VALUE         value;
+  double               x, y, key;
+  float                dx, dy;
+  size_t               tile;
+  int64_t              col, row;
+  int32_t              i, values = 0;
+
+
+  for (i = 0 ; i < block->count ; i++)
+    {
+      /*  Same conversion as load_block in main.c, then shift by the margin and scale to cells.  A grid node is in
+          the middle of its grid cell so the cells start half a grid cell to the left of/below the node.  */
+
+      x = ((block->x[i] - prebin->mbr.wlon) / prebin->x_griddeg + prebin->margin + 0.5) * prebin->factor;
+      y = ((block->y[i] - prebin->mbr.slat) / prebin->y_griddeg + prebin->margin + 0.5) * prebin->factor;
+
+      if (x < 0.0 || y < 0.0 || x >= prebin->cols || y >= prebin->rows)
+        {
+          prebin->out_of_area[thread]++;
+          continue;
+        }
+
+      col = (int64_t) x;
+      row = (int64_t) y;
+
+      tile = (size_t) (row / PREBIN_TILE) * (size_t) prebin->tiles_x + (size_t) (col / PREBIN_TILE);
+
+      if (tiles[tile] == NULL)
+        {
+          if (prebin->num_used[thread] == PREBIN_THREAD_TILES) prebin_flush (prebin, thread);
+
+          tiles[tile] = (PREBIN_CELL *) calloc (PREBIN_TILE * PREBIN_TILE, sizeof (PREBIN_CELL));
+          if (tiles[tile] == NULL)
+            {
+              perror ("Allocating prebin tile");
+              exit (-1);
+            }
+
+          prebin->used[thread][prebin->num_used[thread]++] = tile;
+        }
+
+      value.cell = (uint16_t) ((row % PREBIN_TILE) * PREBIN_TILE + col % PREBIN_TILE);
+      cell = &tiles[tile][value.cell];
+
+
+      /*  Offset from the center of the cell in grid units.  */
+
+      dx = (float) ((x - col - 0.5) / prebin->factor);
+      dy = (float) ((y - row - 0.5) / prebin->factor);
+
+      key = (prebin->method == PREBIN_SHOALEST) ? block->z[i] : dx * dx + dy * dy;
+
+      if (!cell->count || key < cell->best_key)
+        {
+          cell->best_key = key;
+          cell->best_dx = dx;
+          cell->best_dy = dy;
+          cell->best_z = block->z[i];
+        }
+
+      cell->sum_dx += dx;
+      cell->sum_dy += dy;
+      cell->sum_z += block->z[i];
+      cell->count++;
+
+      if (prebin->method == PREBIN_MEDIAN)
+        {
+          value.z = (float) block->z[i];
+          add_values (&prebin->values[thread][tile], &value, 1);
+          values++;
+        }
+    }
+
+
+  /*  The median needs every Z so the only way to bound its memory is to stop.  */
+
+  if (values && atomic_fetch_add (&prebin->num_values, values) + values > prebin->max_values)
+    {
+      fprintf (stderr, "\n\nMedian thinning keeps every Z value (%d bytes per point) until all of the input has been\n",
+               (int32_t) sizeof (PREBIN_VALUE));
+      fprintf (stderr, "read and there are more than %lld MB of them.  Raise [sort_memory_mb] or use another\n",
+               (long long) (prebin->max_values * sizeof (PREBIN_VALUE) / 1048576));
+      fprintf (stderr, "[thin_method].\n\n");
+      fflush (stderr);
+      exit (-1);
+    }
+}
+
+
+
+static int compare_z (const void *a, const void *b)
+{
+  float                za = *(const float *) a, zb = *(const float *) b;
+
+
+  return ((za > zb) - (za < zb));
+}
+
+
+
+/*  Replace best_z in each of a merged tile's cells with the median of the tile's values and free them.  The values
+    are bucketed by cell (the cell counts give the bucket offsets) and each bucket is sorted.  */
+
+static void tile_medians (PREBIN_CELL *cells, PREBIN_VALUES *values)
+{
+  size_t               start[PREBIN_TILE * PREBIN_TILE], next[PREBIN_TILE * PREBIN_TILE], i;
+  float                *z;
+  int32_t              j;
+
+
+  z = (float *) malloc (values->count * sizeof (float));
+  if (z == NULL)
+    {
+      perror ("Allocating prebin medians");
+      exit (-1);
+    }
+
+  for (i = 0, j = 0 ; j < PREBIN_TILE * PREBIN_TILE ; j++)
+    {
+      start[j] = next[j] = i;
+      i += cells[j].count;
+    }
+
+  for (i = 0 ; i < values->count ; i++) z[next[values->value[i].cell]++] = values->value[i].z;
+
+  for (j = 0 ; j < PREBIN_TILE * PREBIN_TILE ; j++)
+    {
+      if (!cells[j].count) continue;
+
+      qsort (&z[start[j]], cells[j].count, sizeof (float), compare_z);
+
+
+      /*  Z is positive down so the lower of the two middle values is the shoaler one.  */
+
+      cells[j].best_z = z[start[j] + (cells[j].count - 1) / 2];
+    }
+
+  free (z);
+  free (values->value);
+  memset (values, 0, sizeof (PREBIN_VALUES));
+}
+
+
+
+/*  Merge thread.  Takes tiles until they're all done and folds what's left of every thread's copy of each tile into
+    the shared set.  The decoder threads are done so there's no locking.  */
+
+static void *merge_tiles (void *arg)
+{
+  PREBIN               *prebin = (PREBIN *) arg;
+  size_t               tile;
+  int32_t              thread;
+
+
+  while ((tile = (size_t) atomic_fetch_add (&prebin->next_tile, 1)) < prebin->num_tiles)
+    {
+      for (thread = 0 ; thread < prebin->max_threads ; thread++) fold_tile (prebin, thread, tile);
+
+      if (prebin->method == PREBIN_MEDIAN && prebin->shared[tile] != NULL)
+        tile_medians (prebin->shared[tile], &prebin->shared_values[tile]);
+    }
+
+  return (NULL);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        prebin_merge                                        *
+*                                                                           *
+*   Purpose:            Fold what's left of the decoder threads' cells into *
+*                       the shared set (using max_threads threads).  Call   *
+*                       this after all of the points have been added.       *
+*                                                                           *
+\***************************************************************************/
+
+void prebin_merge (PREBIN *prebin)
+{
+  pthread_t            *threads;
+  int32_t              i;
+
+
+  atomic_init (&prebin->next_tile, 0);
+
+  threads = (pthread_t *) malloc (prebin->max_threads * sizeof (pthread_t));
+  if (threads == NULL)
+    {
+      perror ("Allocating prebin merge threads");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < prebin->max_threads ; i++)
+    {
+      if (pthread_create (&threads[i], NULL, merge_tiles, prebin))
+        {
+          perror ("Starting prebin merge thread");
+          exit (-1);
+        }
+    }
+
+  for (i = 0 ; i < prebin->max_threads ; i++) pthread_join (threads[i], NULL);
+
+  for (i = 0 ; i < prebin->max_threads ; i++) prebin->num_used[i] = 0;
+
+  free (threads);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        prebin_out_of_area                                  *
+*                                                                           *
+*   Purpose:            Number of points that fell outside of the binned    *
+*                       area (the chart plus the margin).                   *
+*                                                                           *
+\***************************************************************************/
+
+int64_t prebin_out_of_area (PREBIN *prebin)
+{
+  int64_t              total = 0;
+  int32_t              i;
+
+
+  for (i = 0 ; i < prebin->max_threads ; i++) total += prebin->out_of_area[i];
+
+  return (total);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        prebin_emit                                         *
+*                                                                           *
+*   Purpose:            Hand each occupied cell (after prebin_merge) to     *
+*                       emit, a tile at a time.                             *
+*                                                                           *
+\***************************************************************************/
+
+void prebin_emit (PREBIN *prebin, PREBIN_EMIT emit, void *user_data)
+{
+  PREBIN_CELL          *cells, *cell;
+  NV_F64_COORD3        xyz;
+  size_t               tile;
+  int64_t              col, row;
+  int32_t              i;
+
+
+  for (tile = 0 ; tile < prebin->num_tiles ; tile++)
+    {
+      if ((cells = prebin->shared[tile]) == NULL) continue;
+
+      for (i = 0 ; i < PREBIN_TILE * PREBIN_TILE ; i++)
+        {
+          cell = &cells[i];
+          if (!cell->count) continue;
+
+          col = (int64_t) (tile % prebin->tiles_x) * PREBIN_TILE + i % PREBIN_TILE;
+          row = (int64_t) (tile / prebin->tiles_x) * PREBIN_TILE + i / PREBIN_TILE;
+
+
+          /*  Center of the cell in grid units.  */
+
+          xyz.x = (col + 0.5) / prebin->factor - 0.5 - prebin->margin;
+          xyz.y = (row + 0.5) / prebin->factor - 0.5 - prebin->margin;
+
+          switch (prebin->method)
+            {
+            case PREBIN_NEAREST:
+            case PREBIN_SHOALEST:
+              xyz.x += cell->best_dx;
+              xyz.y += cell->best_dy;
+              xyz.z = cell->best_z;
+              break;
+
+            case PREBIN_MEDIAN:
+              xyz.x += cell->sum_dx / cell->count;
+              xyz.y += cell->sum_dy / cell->count;
+              xyz.z = cell->best_z;
+              break;
+
+            default:
+              xyz.x += cell->sum_dx / cell->count;
+              xyz.y += cell->sum_dy / cell->count;
+              xyz.z = cell->sum_z / cell->count;
+              break;
+            }
+
+          (*emit) (xyz, cell->count, user_data);
+        }
+    }
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        prebin_free                                         *
+*                                                                           *
+*   Purpose:            Free the cell accumulators.                         *
+*                                                                           *
+\***************************************************************************/
+
+void prebin_free (PREBIN *prebin)
+{
+  size_t               tile;
+  int32_t              i;
+
+
+  for (i = 0 ; i < prebin->max_threads ; i++)
+    {
+      for (tile = 0 ; tile < prebin->num_tiles ; tile++)
+        {
+          free (prebin->tiles[i][tile]);
+          if (prebin->values[i] != NULL) free (prebin->values[i][tile].value);
+        }
+
+      free (prebin->tiles[i]);
+      free (prebin->values[i]);
+      free (prebin->used[i]);
+    }
+
+  for (tile = 0 ; tile < prebin->num_tiles ; tile++)
+    {
+      free (prebin->shared[tile]);
+      if (prebin->shared_values != NULL) free (prebin->shared_values[tile].value);
+    }
+
+  for (i = 0 ; i < PREBIN_LOCKS ; i++) pthread_mutex_destroy (&prebin->locks[i]);
+
+  free (prebin->tiles);
+  free (prebin->values);
+  free (prebin->used);
+  free (prebin->num_used);
+  free (prebin->shared);
+  free (prebin->shared_values);
+  free (prebin->out_of_area);
+  free (prebin);
+}
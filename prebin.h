@@ -0,0 +1,86 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+
+#ifndef __CHRTR2_PREBIN_H__
+#define __CHRTR2_PREBIN_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+#include "reader.h"
+
+
+/*  Cells are kept in square tiles of PREBIN_TILE x PREBIN_TILE that are only allocated when a point lands in them.  */
+
+#define         PREBIN_TILE             64
+
+
+/*  A decoder thread folds its tiles into the shared set (see prebin_flush) once it has this many of them, so no thread
+    holds more than PREBIN_THREAD_TILES * PREBIN_TILE * PREBIN_TILE cells (48MB) of its own.  */
+
+#define         PREBIN_THREAD_TILES     256
+
+
+/*  Largest [thin_factor] that main.c will accept.  Each grid cell becomes factor x factor sub-cells of 48 bytes so
+    anything bigger than this is more memory than MISP would have used for the points themselves.  */
+
+#define         PREBIN_MAX_FACTOR       16
+
+
+/*  How the point handed to prebin_emit is picked from each cell (see prebin.c).  */
+
+#define         PREBIN_MEAN             0
+#define         PREBIN_NEAREST          1
+#define         PREBIN_SHOALEST         2
+#define         PREBIN_MEDIAN           3
+
+
+typedef struct PREBIN PREBIN;
+
+
+/*  Called by prebin_emit for each occupied cell.  xyz is in grid units (see prebin.c) and count is the number of
+    original points that went into it.  */
+
+typedef void (*PREBIN_EMIT) (NV_F64_COORD3 xyz, int64_t count, void *user_data);
+
+
+PREBIN *prebin_init (NV_F64_MBR *mbr, double x_griddeg, double y_griddeg, int32_t gridcols, int32_t gridrows,
+                     int32_t margin, int32_t max_threads, int32_t factor, int32_t method, int32_t memory_mb);
+void prebin_add (PREBIN *prebin, int32_t thread, READER_BLOCK *block);
+void prebin_flush (PREBIN *prebin, int32_t thread);
+void prebin_merge (PREBIN *prebin);
+int64_t prebin_out_of_area (PREBIN *prebin);
+void prebin_emit (PREBIN *prebin, PREBIN_EMIT emit, void *user_data);
+void prebin_free (PREBIN *prebin);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
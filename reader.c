@@ -38,50 +38,28 @@
 *   Data Security                                                           *
 *   Classification:     Unknown                                             *
 *                                                                           *
-*   Purpose:            Input all the data from the given files in the      *
-*                       input parameter list.                               *
+*   Purpose:            Input all the data from an input file.  All of the  *
+*                       state for an input file is kept in a                *
+*                       READER_CONTEXT so that any number of files can be   *
+*                       read at the same time (e.g. from different          *
+*                       threads).  Usage:                                   *
 *                                                                           *
-*   Inputs:             lat             -   latitude value to pass to       *
-*                                           caller                          *
-*                       lon             -   longitude value to pass to      *
-*                                           caller                          *
-*                       zvalue          -   z value to pass to caller       *
-*                       date_line       -   1 if area crosses date          *
-*                                           line                            *
-*                                                                           *
-*   Outputs:            int             -   1 on end of last data file      *
+*                           ctx = reader_open (file, &options);             *
+*                           while (!reader_read (ctx, block)) {...}         *
+*                           reader_close (ctx);                             *
 *                                                                           *
 *   Calling Routines:   main                                                *
 *                                                                           *
 *   Glossary:           fileptr         -   Pointer for the current file    *
 *                                           being processed.                *
-*                       firstfile       -   Indicate that the first file is *
-*                                           being processed.                *
-*                       filetype    -   Indicates the type of file to       *
-*                                       be read.                            */
-
-
-
-#define         LLZ_FILE        0
-#define         DPG_FILE        1
-#define         RDP_FILE        2
-#define         HOF_FILE        3
-#define         TOF_FILE        4
-#define         GSF_FILE        5
-#define         YXZ_FILE        6
-#define         XYZ_FILE        7
-#define         PFM_FILE        8
-
-
-/*                      count           -   Index counter for the record    *
-*                                           array.                          *
+*                       map             -   Memory mapped DPG or RDP file.  *
+*                       stream          -   Compressed DPG, RDP, YXZ, or    *
+*                                           XYZ file (see decompress.c).    *
+*                       filetype        -   Indicates the type of file to   *
+*                                           be read (see reader.h).         *
 *                       recnum          -   Current record number.          *
-*                       record          -   integer input buffer.           *
-*                       byte_position   -   Current byte position of file.  *
-*                       byte_order      -   4 byte array indicating int     *
-*                                           byte order of rdp file.         *
-*                       zvalue          -   Position in z-direction of an   *
-*                                           xyz-coordinate system.          *
+*                       eof             -   Size of the current file.       *
+*                       byte_swap       -   Byte swap DPG or RDP records.   *
 *                                                                           *
 *									    *
 *   Modifications:	Sam Mangin, PSI 6/01 - Added a swap byte check      *
@@ -89,6 +67,14 @@
 *									    *
 \***************************************************************************/
 
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifndef NVWIN3X
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
 #include "FileHydroOutput.h"
 #include "FileTopoOutput.h"
 
@@ -100,36 +86,675 @@
 
 #include "llz.h"
 
-    
+#include "reader.h"
+#include "mapfile.h"
+#include "ascii.h"
+#include "geolocate.h"
+#include "decompress.h"
+#include "las.h"
+#include "pointfile.h"
+
+
+/*  Starting size of the window that compressed DPG, RDP, YXZ, and XYZ files are decompressed into.  It's doubled if
+    an ASCII line won't fit.  */
+
+#define READER_STREAM_WINDOW    (8 * 1024 * 1024)
+
+
+
+/*  All of the state needed to read one input file.  This used to be a bunch of function level statics in reader and
+    openfile which meant that you could only read one file at a time.  */
+
+struct READER_CONTEXT
+{
+  char                 *filename;
+  int32_t              filetype;
+  READER_OPTIONS       options;
+  FILE                 *fileptr;            /*  HOF, TOF, and LAS files  */
+  int32_t              handle;              /*  GSF, PFM, and LLZ files  */
+  int64_t              eof;
+  int64_t              recnum;
+  int64_t              num_shots;           /*  HOF and TOF shot (or LAS point) to stop at  */
+  int64_t              first_shot;
+  void                 *record_buffer;      /*  Block of HOF, TOF, LAS, or LLZ records  */
+  int64_t              record_buffer_size;
+  int32_t              percent;
+  uint8_t              byte_swap;
+  uint8_t              just_opened;
+  uint8_t              file_done;
+
+
+  /*  DPG, RDP, YXZ, and XYZ (memory mapped)  */
+
+  MAPPED_FILE          map;
+  READER_RANGE         range;               /*  Part of the file we're reading (bytes for YXZ and XYZ)  */
+  const char           *text;               /*  Start of the next YXZ or XYZ line  */
+  const char           *text_end;           /*  Lines starting at or after this belong to the next range  */
+  const uint32_t       *words;              /*  First word of the first record  */
+  int64_t              map_records;
+  int64_t              map_pos;
+  uint32_t             *swap_buffer;
+  uint8_t              *valid;
+  int32_t              scratch_size;
+
+
+  /*  Compressed DPG, RDP, YXZ, and XYZ files are decompressed into a window instead of being mapped.  words and
+      map_records (or text and text_end) then describe what's in the window and refill_window slides it along.  */
+
+  DECOMPRESS_STREAM    *stream;
+  uint8_t              *window;
+  int64_t              window_size;
+  int64_t              window_len;
+  uint8_t              stream_done;
+  uint8_t              stream_pipe;         /*  Pipe, parse what has arrived instead of waiting for a full window  */
+
+
+  /*  Point files (memory mapped)  */
+
+  POINTFILE_HEADER     *pf_head;
+  POINTFILE_CHUNK      *pf_chunks;
+  int64_t              chunk;               /*  Next chunk to read  */
+  int64_t              first_chunk;
+  int64_t              last_chunk;          /*  One past the last chunk in our range  */
+  int64_t              chunk_pos;           /*  Next point in the current chunk  */
+
+
+  /*  GSF  */
+
+  gsfDataID            gsf_data_id;
+  gsfRecords           gsf_records;
+  int32_t              beam_num;
+  int32_t              total_beams;
+  uint8_t              gsf_direct;          /*  Reading a range of pings through the GSF index  */
+  int32_t              gsf_ping;            /*  Next ping to read (direct access, one based)  */
+  int32_t              gsf_first_ping;
+  int32_t              gsf_last_ping;
+  int64_t              culled;              /*  Pings skipped because they were outside of cull_mbr  */
+  double               *beam_y;             /*  Beam positions for the current ping  */
+  double               *beam_x;
+  int32_t              beam_size;
+
+
+  /*  PFM  */
+
+  PFM_OPEN_ARGS        open_args;
+  int32_t              row;                 /*  Next bin row to read  */
+  int32_t              first_row;           /*  Bin window that overlaps cull_mbr (or the whole PFM)  */
+  int32_t              last_row;
+  int32_t              first_col;
+  int32_t              num_cols;
+  BIN_RECORD           *bin_row;            /*  Bin records for one row  */
+  DEPTH_RECORD         *row_depth;          /*  All of the soundings for one row  */
+  int64_t              row_depth_size;
+  double               *row_x;              /*  Valid soundings for one row  */
+  double               *row_y;
+  double               *row_z;
+  int64_t              row_size;
+  int64_t              row_points;
+  int64_t              row_pos;             /*  Next valid sounding to return  */
+
+
+  /*  LLZ, HOF, TOF, and LAS  */
+
+  LLZ_HEADER           llz_header;
+  HOF_HEADER_T         hof_head;
+  TOF_HEADER_T         tof_head;
+  LAS_HEADER           las_head;
+};
+
+
+
+/*  The GSF, PFM, and LLZ libraries keep their open file tables (and, in some versions, scratch buffers) in globals
+    so we serialize calls into them when more than one context is being read at once.  Each library has its own lock
+    so that, for instance, a GSF index being built doesn't hold up the PFM readers.  Opens and closes are always
+    serialized.  Reads are serialized unless READER_REENTRANT_LIBS is defined.  Everything we do with the records after
+    we get them back (e.g. positioning GSF beams) runs outside of the lock.  */
+
+static pthread_mutex_t gsf_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pfm_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t llz_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t other_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static pthread_mutex_t *library_mutex (int32_t filetype)
+{
+  switch (filetype)
+    {
+    case GSF_FILE:
+      return (&gsf_mutex);
+
+    case PFM_FILE:
+      return (&pfm_mutex);
+
+    case LLZ_FILE:
+      return (&llz_mutex);
+    }
+
+  return (&other_mutex);
+}
+
+#define LOCK_LIBRARY(t)    pthread_mutex_lock (library_mutex (t))
+#define UNLOCK_LIBRARY(t)  pthread_mutex_unlock (library_mutex (t))
+
+#ifdef READER_REENTRANT_LIBS
+  #define LOCK_READ(t)
+  #define UNLOCK_READ(t)
+#else
+  #define LOCK_READ(t)     LOCK_LIBRARY (t)
+  #define UNLOCK_READ(t)   UNLOCK_LIBRARY (t)
+#endif
 
-static PFM_OPEN_ARGS        open_args;
-static LLZ_HEADER           llz_header;
 
 
 int32_t big_endian ();
 
 
-static void this_swap_int (int32_t *word)
+
+/*  Check the bounds of a file against cull_mbr.  Returns NVTrue if they can't overlap.  The file may be in either
+    -180 to 180 or 0 to 360 (and may itself cross the date line) so we try it shifted a full turn each way.  */
+
+static uint8_t outside_area (READER_OPTIONS *options, NV_F64_MBR *bounds)
+{
+  NV_F64_MBR           *mbr = &options->cull_mbr;
+  double               shift, elon;
+  int32_t              i;
+
+
+  if (!options->cull) return (NVFalse);
+
+  if (bounds->slat > mbr->nlat || bounds->nlat < mbr->slat) return (NVTrue);
+
+  elon = bounds->elon;
+  if (elon < bounds->wlon) elon += 360.0;
+
+  for (i = -1 ; i <= 1 ; i++)
+    {
+      shift = (double) i * 360.0;
+
+      if (bounds->wlon + shift <= mbr->elon && elon + shift >= mbr->wlon) return (NVFalse);
+    }
+
+  return (NVTrue);
+}
+
+
+
+/*  Work out which PFM bins can have soundings in cull_mbr (already expanded by the search radius) so we don't read
+    the rest of the PFM.  If the chart crosses the date line the PFM may be in either -180 to 180 or 0 to 360 so we
+    try it both ways (and a full turn the other way) and take every bin column that overlaps.  With no cull_mbr we
+    read the whole thing.  */
+
+static void pfm_window (READER_CONTEXT *ctx)
+{
+  PFM_HEADER           *head = &ctx->open_args.head;
+  NV_F64_MBR           *mbr = &ctx->options.cull_mbr;
+  double               shift;
+  int32_t              first, last, end, i;
+
+
+  ctx->first_row = 0;
+  ctx->last_row = head->bin_height - 1;
+  ctx->first_col = 0;
+  ctx->num_cols = head->bin_width;
+
+  if (!ctx->options.cull) return;
+
+
+  first = (int32_t) floor ((mbr->slat - head->mbr.min_y) / head->y_bin_size_degrees);
+  last = (int32_t) floor ((mbr->nlat - head->mbr.min_y) / head->y_bin_size_degrees);
+
+  ctx->first_row = MAX (first, 0);
+  ctx->last_row = MIN (last, head->bin_height - 1);
+
+
+  ctx->first_col = head->bin_width;
+  last = -1;
+
+  for (i = -1 ; i <= 1 ; i++)
+    {
+      shift = (double) i * 360.0;
+
+      first = (int32_t) floor ((mbr->wlon + shift - head->mbr.min_x) / head->x_bin_size_degrees);
+      first = MAX (first, 0);
+      end = (int32_t) floor ((mbr->elon + shift - head->mbr.min_x) / head->x_bin_size_degrees);
+      end = MIN (end, head->bin_width - 1);
+
+      if (first <= end)
+        {
+          ctx->first_col = MIN (ctx->first_col, first);
+          last = MAX (last, end);
+        }
+    }
+
+  ctx->num_cols = last - ctx->first_col + 1;
+
+  if (ctx->num_cols <= 0 || ctx->first_row > ctx->last_row)
+    {
+      ctx->first_col = 0;
+      ctx->num_cols = 0;
+      ctx->last_row = ctx->first_row - 1;
+    }
+}
+
+
+
+/*  Drop the first consumed bytes of the decompression window, slide the rest to the front, and top the window up from
+    the stream.  If nothing was consumed and the window is full (an ASCII line longer than the window) the window is
+    doubled.  A pipe may be slow so for one we stop topping up as soon as there's a complete record or line.  Then
+    point words and map_records (DPG, RDP) or text and text_end (YXZ, XYZ) at the new contents.  Partial records and
+    lines are left at the end of the window for the next refill.  */
+
+static void refill_window (READER_CONTEXT *ctx, int64_t consumed)
+{
+  int64_t              n, old_len;
+  const char           *last;
+
+
+  ctx->window_len -= consumed;
+  if (ctx->window_len) memmove (ctx->window, ctx->window + consumed, ctx->window_len);
+
+  if (ctx->window_len == ctx->window_size)
+    {
+      ctx->window_size *= 2;
+      ctx->window = (uint8_t *) realloc (ctx->window, ctx->window_size);
+      if (ctx->window == NULL)
+        {
+          perror ("Allocating decompression window");
+          exit (-1);
+        }
+    }
+
+  while (!ctx->stream_done && ctx->window_len < ctx->window_size)
+    {
+      old_len = ctx->window_len;
+
+      n = decompress_read (ctx->stream, ctx->window + ctx->window_len, ctx->window_size - ctx->window_len);
+
+      if (n < 0)
+        {
+          fprintf (stderr, "\n\nError decompressing file %s, the rest of the file will be ignored\n", ctx->filename);
+          fflush (stderr);
+        }
+
+      if (n <= 0)
+        {
+          ctx->stream_done = NVTrue;
+        }
+      else
+        {
+          ctx->window_len += n;
+
+          if (ctx->stream_pipe)
+            {
+              if (ctx->filetype == DPG_FILE || ctx->filetype == RDP_FILE)
+                {
+                  if (ctx->window_len >= (int64_t) (3 * sizeof (uint32_t))) break;
+                }
+              else
+                {
+                  /*  Whatever was left in the window before this read has no newline in it.  */
+
+                  if (memchr (ctx->window + old_len, '\n', n) != NULL) break;
+                }
+            }
+        }
+    }
+
+
+  if (ctx->filetype == DPG_FILE || ctx->filetype == RDP_FILE)
+    {
+      ctx->words = (const uint32_t *) ctx->window;
+      ctx->map_records = ctx->window_len / (3 * sizeof (uint32_t));
+      ctx->map_pos = 0;
+    }
+  else
+    {
+      ctx->text = (const char *) ctx->window;
+      ctx->text_end = (const char *) ctx->window + ctx->window_len;
+
+
+      /*  Stop after the last complete line unless there's no more coming.  */
+
+      if (!ctx->stream_done)
+        {
+          for (last = ctx->text_end ; last > ctx->text && last[-1] != '\n' ; last--);
+          ctx->text_end = last;
+        }
+    }
+}
+
+
+
+/*  Check a GSF ping's swath footprint (the nadir position plus the largest beam offset in any direction) against the
+    area of interest.  Returns NVTrue if the whole swath is outside.  The meters to degrees conversion is on the short
+    side (110 km per degree) so we never cull a ping that has a beam inside.  */
+
+static uint8_t cull_ping (READER_CONTEXT *ctx, gsfSwathBathyPing *ping)
 {
-  uint32_t      temp[4];
+  double               max_across = 0.0, max_along = 0.0, dist, dlat, dlon, lon;
+  int32_t              i;
 
-  temp[0] = *word & 0x000000ff;
 
-  temp[1] = (*word & 0x0000ff00) >> 8;
+  if (ping->across_track != NULL)
+    {
+      for (i = 0 ; i < ping->number_beams ; i++) max_across = MAX (max_across, fabs (ping->across_track[i]));
+    }
 
-  temp[2] = (*word & 0x00ff0000) >> 16;
+  if (ping->along_track != NULL)
+    {
+      for (i = 0 ; i < ping->number_beams ; i++) max_along = MAX (max_along, fabs (ping->along_track[i]));
+    }
+
+  dist = sqrt (max_across * max_across + max_along * max_along);
+
+  dlat = dist / 110000.0;
+  if (fabs (ping->latitude) + dlat >= 89.0) return (NVFalse);
+  dlon = dlat / cos (ping->latitude * NV_DEG_TO_RAD);
 
-  temp[3] = (*word & 0xff000000) >> 24;
+  lon = ping->longitude;
+  if (ctx->options.date_line && lon < 0.0) lon += 360.0;
 
-  *word = (temp[0] << 24) + (temp[1] << 16) + (temp[2] << 8) + temp[3];
+  if (ping->latitude + dlat < ctx->options.cull_mbr.slat || ping->latitude - dlat > ctx->options.cull_mbr.nlat ||
+      lon + dlon < ctx->options.cull_mbr.wlon || lon - dlon > ctx->options.cull_mbr.elon) return (NVTrue);
+
+  return (NVFalse);
 }
 
 
-static void swap_rdp (int32_t rdp_record[])
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_file_type                                    *
+*                                                                           *
+*   Purpose:            Determine the type of an input file from its name.  *
+*                       Anything we don't recognize is assumed to be GSF.   *
+*                       Standard input ("-") is always YXZ.                 *
+*                                                                           *
+*   Inputs:             file        -   file name                           *
+*                                                                           *
+*   Outputs:            int32_t     -   file type (see reader.h)            *
+*                                                                           *
+\***************************************************************************/
+
+int32_t reader_file_type (char *file)
 {
-  this_swap_int (&rdp_record[0]);
-  this_swap_int (&rdp_record[1]);
-  this_swap_int (&rdp_record[2]);
+  if (!strcmp (file, DECOMPRESS_STDIN)) return (YXZ_FILE);
+  if (strstr (file, ".llz") != NULL) return (LLZ_FILE);
+  if (strstr (file, ".dpg") != NULL) return (DPG_FILE);
+  if (strstr (file, ".rdp") != NULL) return (RDP_FILE);
+  if (strstr (file, ".hof") != NULL) return (HOF_FILE);
+  if (strstr (file, ".tof") != NULL) return (TOF_FILE);
+  if (strstr (file, ".txt") != NULL || strstr (file, ".yxz") != NULL || strstr (file, ".raw") != NULL) return (YXZ_FILE);
+  if (strstr (file, ".xyz") != NULL) return (XYZ_FILE);
+  if (strstr (file, ".pfm") != NULL) return (PFM_FILE);
+  if (strstr (file, ".las") != NULL) return (LAS_FILE);
+  if (strstr (file, POINTFILE_EXTENSION) != NULL) return (CH2P_FILE);
+
+  return (GSF_FILE);
+}
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_plan                                         *
+*                                                                           *
+*   Purpose:            Split an input file into ranges that can be read    *
+*                       independently (with reader_open_range) by different *
+*                       threads.  Big YXZ and XYZ files are cut into        *
+*                       READER_ASCII_CHUNK byte pieces (reader_open_range   *
+*                       moves the cut to the next line).  Big GSF files are *
+*                       cut into READER_GSF_PINGS ping pieces using the GSF *
+*                       index (which gsfOpen builds if it isn't there, so   *
+*                       it's only used on files of at least                 *
+*                       READER_GSF_SPLIT_SIZE bytes).                       *
+*                       Big HOF and TOF files are cut into                  *
+*                       READER_LIDAR_SHOTS shot pieces (or into             *
+*                       options->min_ranges pieces of at least              *
+*                       READER_LIDAR_MIN_SHOTS shots if that gives more of  *
+*                       them).  Big LAS files are cut into                  *
+*                       READER_LAS_POINTS point pieces and big point files  *
+*                       into READER_POINT_CHUNKS chunk pieces.              *
+*                       Big PFM files are cut into READER_PFM_ROWS row      *
+*                       bands (only counting the rows in the bin window,    *
+*                       see pfm_window), or into options->min_ranges bands  *
+*                       of at least READER_PFM_MIN_ROWS rows if that gives  *
+*                       more of them.  Everything else is one range         *
+*                       covering the whole file.  Compressed files and      *
+*                       pipes (see decompress.c) are always one range.      *
+*                                                                           *
+*                       If options->cull is set and the PFM, HOF, TOF, LAS, *
+*                       or point file header or the GSF summary record      *
+*                       shows that none of the file's data can be in        *
+*                       cull_mbr we return no ranges (LLZ, DPG, RDP, and    *
+*                       ASCII files don't carry their bounds so they're     *
+*                       always read).  Point files also skip the chunks     *
+*                       outside of cull_mbr as they're read.                *
+*                                                                           *
+*   Inputs:             file        -   file name                           *
+*                       options     -   reader options (see reader.h)       *
+*                       ranges      -   the ranges (free when done)         *
+*                                                                           *
+*   Outputs:            int32_t     -   number of ranges (0 if the file     *
+*                                       can be skipped)                     *
+*                                                                           *
+\***************************************************************************/
+
+int32_t reader_plan (char *file, READER_OPTIONS *options, READER_RANGE **ranges)
+{
+  struct stat          st;
+  READER_CONTEXT       pfm;
+  FILE                 *fp;
+  HOF_HEADER_T         hof_head;
+  TOF_HEADER_T         tof_head;
+  LAS_HEADER           las_head;
+  POINTFILE_HEADER     pf_head;
+  gsfDataID            gsf_data_id;
+  gsfRecords           gsf_records;
+  NV_F64_MBR           bounds = {0.0, 0.0, 0.0, 0.0};
+  uint8_t              have_bounds = NVFalse, split;
+  int32_t              i, count = 1, handle, status;
+  int64_t              size = 0, chunk = 1, base = 0;
+
+
+  /*  Compressed files and pipes have to be read front to back by one thread so they're never split.  */
+
+  if (decompress_type (file) != DECOMPRESS_NONE || decompress_is_pipe (file)) size = -1;
+
+
+  if (size >= 0) switch (reader_file_type (file))
+    {
+    case YXZ_FILE:
+    case XYZ_FILE:
+      if (!stat (file, &st))
+        {
+          size = st.st_size;
+          chunk = READER_ASCII_CHUNK;
+        }
+      break;
+
+    case GSF_FILE:
+
+      /*  Counting the pings takes the index and gsfOpen builds the index (and writes it next to the file) if it isn't
+          there, which means reading the whole file.  So only files that are big enough to be split are opened with the
+          index.  For the rest we just look at the first record for the swath bathymetry summary.  */
+
+      if (stat (file, &st)) break;
+
+      split = (st.st_size >= READER_GSF_SPLIT_SIZE);
+
+      LOCK_LIBRARY (GSF_FILE);
+      if (gsfOpen (file, split ? GSF_READONLY_INDEX : GSF_READONLY, &handle) != -1)
+        {
+          memset (&gsf_records, 0, sizeof (gsfRecords));
+          memset (&gsf_data_id, 0, sizeof (gsfDataID));
+          status = -1;
+
+          if (split)
+            {
+              size = gsfGetNumberRecords (handle, GSF_RECORD_SWATH_BATHYMETRY_PING);
+              chunk = READER_GSF_PINGS;
+
+              if (options->cull && gsfGetNumberRecords (handle, GSF_RECORD_SWATH_BATHY_SUMMARY) > 0)
+                {
+                  gsf_data_id.recordID = GSF_RECORD_SWATH_BATHY_SUMMARY;
+                  gsf_data_id.record_number = 1;
+
+                  status = gsfRead (handle, GSF_RECORD_SWATH_BATHY_SUMMARY, &gsf_data_id, &gsf_records, NULL, 0);
+                }
+            }
+          else if (options->cull)
+            {
+              status = gsfRead (handle, GSF_NEXT_RECORD, &gsf_data_id, &gsf_records, NULL, 0);
+            }
+
+
+          /*  The swath bathymetry summary record (if there is one) has the bounds of all of the beams.  */
+
+          if (status != -1 && gsf_data_id.recordID == GSF_RECORD_SWATH_BATHY_SUMMARY)
+            {
+              bounds.slat = gsf_records.summary.min_latitude;
+              bounds.nlat = gsf_records.summary.max_latitude;
+              bounds.wlon = gsf_records.summary.min_longitude;
+              bounds.elon = gsf_records.summary.max_longitude;
+              have_bounds = NVTrue;
+            }
+
+          gsfFree (&gsf_records);
+          gsfClose (handle);
+        }
+      UNLOCK_LIBRARY (GSF_FILE);
+      break;
+
+    case HOF_FILE:
+    case TOF_FILE:
+      if (!stat (file, &st))
+        {
+          if (reader_file_type (file) == HOF_FILE)
+            {
+              size = (st.st_size - HOF_HEAD_SIZE) / sizeof (HYDRO_OUTPUT_T);
+
+              if (options->cull && (fp = open_hof_file (file)) != NULL)
+                {
+                  hof_read_header (fp, &hof_head);
+                  bounds.slat = hof_head.text.min_lat;
+                  bounds.nlat = hof_head.text.max_lat;
+                  bounds.wlon = hof_head.text.min_lon;
+                  bounds.elon = hof_head.text.max_lon;
+                  have_bounds = NVTrue;
+                  fclose (fp);
+                }
+            }
+          else
+            {
+              size = (st.st_size - TOF_HEAD_SIZE) / sizeof (TOPO_OUTPUT_T);
+
+              if (options->cull && (fp = open_tof_file (file)) != NULL)
+                {
+                  tof_read_header (fp, &tof_head);
+                  bounds.slat = tof_head.text.min_lat;
+                  bounds.nlat = tof_head.text.max_lat;
+                  bounds.wlon = tof_head.text.min_lon;
+                  bounds.elon = tof_head.text.max_lon;
+                  have_bounds = NVTrue;
+                  fclose (fp);
+                }
+            }
+          chunk = READER_LIDAR_SHOTS;
+
+          if (options->min_ranges > 1)
+            chunk = MAX (MIN (chunk, (size + options->min_ranges - 1) / options->min_ranges), READER_LIDAR_MIN_SHOTS);
+        }
+      break;
+
+    case LAS_FILE:
+      if ((fp = fopen (file, "rb")) != NULL)
+        {
+          if (!las_read_header (fp, file, &las_head))
+            {
+              size = las_head.num_points;
+              chunk = READER_LAS_POINTS;
+
+              bounds.slat = las_head.min_y;
+              bounds.nlat = las_head.max_y;
+              bounds.wlon = las_head.min_x;
+              bounds.elon = las_head.max_x;
+              have_bounds = NVTrue;
+            }
+          fclose (fp);
+        }
+      break;
+
+    case CH2P_FILE:
+      if ((fp = fopen (file, "rb")) != NULL)
+        {
+          if (fread (&pf_head, sizeof (POINTFILE_HEADER), 1, fp) == 1 && !strcmp (pf_head.magic, POINTFILE_MAGIC))
+            {
+              size = pf_head.num_chunks;
+              chunk = READER_POINT_CHUNKS;
+
+              bounds.slat = pf_head.min_y;
+              bounds.nlat = pf_head.max_y;
+              bounds.wlon = pf_head.min_x;
+              bounds.elon = pf_head.max_x;
+              have_bounds = (pf_head.num_points > 0);
+            }
+          fclose (fp);
+        }
+      break;
+
+    case PFM_FILE:
+      memset (&pfm, 0, sizeof (READER_CONTEXT));
+      pfm.options = *options;
+      pfm.open_args.checkpoint = 0;
+      strcpy (pfm.open_args.list_path, file);
+
+      LOCK_LIBRARY (PFM_FILE);
+      if ((handle = open_existing_pfm_file (&pfm.open_args)) >= 0)
+        {
+          close_pfm_file (handle);
+          pfm_window (&pfm);
+
+          bounds.slat = pfm.open_args.head.mbr.min_y;
+          bounds.nlat = pfm.open_args.head.mbr.max_y;
+          bounds.wlon = pfm.open_args.head.mbr.min_x;
+          bounds.elon = pfm.open_args.head.mbr.max_x;
+          have_bounds = NVTrue;
+          base = pfm.first_row;
+          size = pfm.last_row - pfm.first_row + 1;
+          chunk = READER_PFM_ROWS;
+
+          if (options->min_ranges > 1)
+            chunk = MAX (MIN (chunk, (size + options->min_ranges - 1) / options->min_ranges), READER_PFM_MIN_ROWS);
+        }
+      UNLOCK_LIBRARY (PFM_FILE);
+      break;
+    }
+
+  /*  Nothing in this file can make it into the chart.  */
+
+  if (have_bounds && outside_area (options, &bounds))
+    {
+      *ranges = NULL;
+      return (0);
+    }
+
+
+  if (size >= 2 * chunk) count = (size + chunk - 1) / chunk;
+
+
+  *ranges = (READER_RANGE *) malloc (count * sizeof (READER_RANGE));
+  if (*ranges == NULL)
+    {
+      perror ("Allocating reader ranges");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < count ; i++)
+    {
+      (*ranges)[i].start = base + (int64_t) i * chunk;
+      (*ranges)[i].end = (i == count - 1) ? -1 : base + (int64_t) (i + 1) * chunk;
+    }
+
+  return (count);
 }
 
 
@@ -139,7 +764,7 @@ static void swap_rdp (int32_t rdp_record[])
 *                                                                           *
 *   Date Written:       July 1992                                           *
 *                                                                           *
-*   Module Name:        openfile                                            *
+*   Module Name:        reader_open, reader_open_range                      *
 *                                                                           *
 *   Module Security                                                         *
 *   Classification:     Unclassified                                        *
@@ -147,347 +772,884 @@ static void swap_rdp (int32_t rdp_record[])
 *   Data Security                                                           *
 *   Classification:     Unknown                                             *
 *                                                                           *
-*   Purpose:            Input all the files from the parameter list.        *
+*   Purpose:            Open an input file (or part of one, see             *
+*                       reader_plan) and create the reader context for it.  *
 *                                                                           *
-*   Inputs:             file        -   array of file names                 *
-*                       numfiles    -   number of input files               *
-*                       fileptr     -   input file pointers                 *
-*                       filetype    -   Indicates the type of file          *
-*                                       see #define's above                 *
-*                       handle      -   handle, if this is a GSF, PFM, or   *
-*                                       LLZ file                            *
-*                       open_args   -   PFM_OPEN_ARGS                       *
-*                       llz_header  -   LLZ header                          *
+*   Inputs:             file        -   file name                           *
+*                       range       -   part of the file to read (NULL for  *
+*                                       the whole file)                     *
+*                       options     -   reader options (see reader.h)       *
 *                                                                           *
-*   Outputs:            int32_t     -   1 on end of last file               *
+*   Outputs:            READER_CONTEXT * - context or NULL on failure (the  *
+*                                       error will have been printed)       *
 *                                                                           *
-*   Calling Routines:   read_files                                          *
+*   Calling Routines:   main                                                *
 *                                                                           *
 \***************************************************************************/
 
-static int32_t openfile (char *file[], int32_t numfiles, FILE **fileptr, int32_t *filetype, int32_t *handle)
+READER_CONTEXT *reader_open (char *file, READER_OPTIONS *options)
 {
-  static int32_t       filecount = 0, prev_filetype = -1;
+  return (reader_open_range (file, NULL, options));
+}
 
 
-  int32_t open_out_file (char *, FILE **);
+READER_CONTEXT *reader_open_range (char *file, READER_RANGE *range, READER_OPTIONS *options)
+{
+  READER_CONTEXT       *ctx;
+  int64_t              byte_position, record_size;
+  int32_t              endian;
+
 
+  uint8_t checkinput (const float *records, int64_t num_records);
 
 
-  /* If it is not the first input file close it                       */
 
-  if (prev_filetype != -1)
+  ctx = (READER_CONTEXT *) calloc (1, sizeof (READER_CONTEXT));
+  if (ctx == NULL)
+    {
+      perror ("Allocating reader context");
+      return (NULL);
+    }
+
+  ctx->filename = strdup (file);
+  ctx->filetype = reader_file_type (file);
+  ctx->options = *options;
+  ctx->handle = -1;
+  ctx->beam_num = -1;
+  ctx->percent = 0;
+  ctx->just_opened = NVTrue;
+  ctx->file_done = NVFalse;
+
+  if (range != NULL)
+    {
+      ctx->range = *range;
+    }
+  else
     {
-      if (prev_filetype == GSF_FILE)
+      ctx->range.start = 0;
+      ctx->range.end = -1;
+    }
+
+
+  /*  Only the formats that we read front to back ourselves can be decompressed on the fly or read from a pipe.  */
+
+  if ((decompress_type (file) != DECOMPRESS_NONE || decompress_is_pipe (file)) && ctx->filetype != DPG_FILE &&
+      ctx->filetype != RDP_FILE && ctx->filetype != YXZ_FILE && ctx->filetype != XYZ_FILE)
+    {
+      fprintf (stderr, "\n\nCompressed and piped input is only supported for DPG, RDP, YXZ, and XYZ files, unable to read %s\n",
+               file);
+      fflush (stderr);
+      reader_close (ctx);
+      return (NULL);
+    }
+
+
+  switch (ctx->filetype)
+    {
+    case LLZ_FILE:
+      LOCK_LIBRARY (LLZ_FILE);
+      ctx->handle = open_llz (file, &ctx->llz_header);
+      UNLOCK_LIBRARY (LLZ_FILE);
+
+      if (ctx->handle < 0)
         {
-          gsfClose (*handle);
+          perror (file);
+          reader_close (ctx);
+          return (NULL);
         }
-      else if (prev_filetype == PFM_FILE)
+      break;
+
+    case PFM_FILE:
+      ctx->open_args.checkpoint = 0;
+      strcpy (ctx->open_args.list_path, file);
+
+      LOCK_LIBRARY (PFM_FILE);
+      ctx->handle = open_existing_pfm_file (&ctx->open_args);
+      UNLOCK_LIBRARY (PFM_FILE);
+
+      if (ctx->handle < 0)
         {
-          close_pfm_file (*handle);
+          pfm_error_exit (pfm_error);
         }
-      else if (prev_filetype == LLZ_FILE)
+
+      pfm_window (ctx);
+
+
+      /*  Row band (see reader_plan).  */
+
+      ctx->first_row = MAX (ctx->first_row, ctx->range.start);
+      if (ctx->range.end >= 0) ctx->last_row = MIN (ctx->last_row, ctx->range.end - 1);
+
+      ctx->row = ctx->first_row;
+
+      ctx->bin_row = (BIN_RECORD *) malloc (MAX (ctx->num_cols, 1) * sizeof (BIN_RECORD));
+      if (ctx->bin_row == NULL)
         {
-          close_llz (*handle);
+          perror ("Allocating PFM bin row");
+          exit (-1);
         }
-      else
+      break;
+
+    case GSF_FILE:
+
+      /*  Part of a file gets read directly from the index so we only decode the pings in our range (and none of the
+          attitude, SVP, or comment records in between).  */
+
+      ctx->gsf_direct = (ctx->range.start > 0 || ctx->range.end >= 0);
+
+      LOCK_LIBRARY (GSF_FILE);
+      if (gsfOpen (file, ctx->gsf_direct ? GSF_READONLY_INDEX : GSF_READONLY, &ctx->handle) == -1)
+        {
+          fprintf (stderr, "\n\nUnable to open file %s\n", file);
+          gsfPrintError (stderr);
+          UNLOCK_LIBRARY (GSF_FILE);
+          ctx->handle = -1;
+          reader_close (ctx);
+          return (NULL);
+        }
+
+      if (ctx->gsf_direct)
+        {
+          ctx->gsf_last_ping = gsfGetNumberRecords (ctx->handle, GSF_RECORD_SWATH_BATHYMETRY_PING);
+          if (ctx->range.end >= 0 && ctx->range.end < ctx->gsf_last_ping) ctx->gsf_last_ping = ctx->range.end;
+          ctx->gsf_first_ping = ctx->gsf_ping = ctx->range.start + 1;
+        }
+      UNLOCK_LIBRARY (GSF_FILE);
+      break;
+
+    case DPG_FILE:
+    case RDP_FILE:
+    case YXZ_FILE:
+    case XYZ_FILE:
+      if (decompress_type (file) != DECOMPRESS_NONE || decompress_is_pipe (file))
+        {
+          if ((ctx->stream = decompress_open (file)) == NULL)
+            {
+              reader_close (ctx);
+              return (NULL);
+            }
+
+          ctx->stream_pipe = decompress_is_pipe (file);
+
+          ctx->window_size = READER_STREAM_WINDOW;
+          ctx->window = (uint8_t *) malloc (ctx->window_size);
+          if (ctx->window == NULL)
+            {
+              perror ("Allocating decompression window");
+              exit (-1);
+            }
+          break;
+        }
+
+      if (map_file (file, &ctx->map))
         {
-          fclose (*fileptr);
+          perror (file);
+          reader_close (ctx);
+          return (NULL);
         }
+      ctx->eof = ctx->map.size;
+      break;
+
+    case HOF_FILE:
+      ctx->fileptr = open_hof_file (file);
+      break;
+
+    case TOF_FILE:
+      ctx->fileptr = open_tof_file (file);
+      break;
+
+    case LAS_FILE:
+      ctx->fileptr = fopen (file, "rb");
+      break;
+
+    case CH2P_FILE:
+      if (map_file (file, &ctx->map))
+        {
+          perror (file);
+          reader_close (ctx);
+          return (NULL);
+        }
+
+      ctx->pf_head = (POINTFILE_HEADER *) ctx->map.data;
+
+      if (!pointfile_check (ctx->pf_head, ctx->map.size, file))
+        {
+          reader_close (ctx);
+          return (NULL);
+        }
+
+      ctx->pf_chunks = (POINTFILE_CHUNK *) (ctx->map.data + ctx->pf_head->index_offset);
+      ctx->last_chunk = ctx->pf_head->num_chunks;
+      if (ctx->range.end >= 0 && ctx->range.end < ctx->last_chunk) ctx->last_chunk = ctx->range.end;
+      ctx->first_chunk = ctx->chunk = MIN (ctx->range.start, ctx->last_chunk);
+      ctx->eof = ctx->map.size;
+      break;
     }
 
-  if (filecount == numfiles)
+
+  if (ctx->filetype == HOF_FILE || ctx->filetype == TOF_FILE || ctx->filetype == LAS_FILE)
     {
-      return (1);
-    }
+      if (ctx->fileptr == NULL)
+        {
+          perror (file);
+          reader_close (ctx);
+          return (NULL);
+        }
 
+      byte_position = ftello (ctx->fileptr);
+      fseeko (ctx->fileptr, 0, SEEK_END);
+      ctx->eof = ftello (ctx->fileptr);
+      fseeko (ctx->fileptr, byte_position, SEEK_SET);
+    }
 
-  fprintf (stderr, "\n\nData file %03d of %03d: %s\n\n", filecount + 1, numfiles, file[filecount]);
-  fflush (stderr);
 
-  if (strstr (file[filecount], ".llz") != NULL)
+  switch (ctx->filetype)
     {
-      *handle = open_llz (file[filecount], &llz_header);
+    case DPG_FILE:
+      if (ctx->stream != NULL)
+        {
+          refill_window (ctx, 0);
+          ctx->byte_swap = checkinput ((const float *) ctx->words, ctx->map_records);
+          break;
+        }
 
-      if (*handle < 0)
+      ctx->words = (const uint32_t *) ctx->map.data;
+      ctx->map_records = ctx->map.size / (3 * sizeof (float));
+      ctx->byte_swap = checkinput ((const float *) ctx->words, ctx->map_records);			/*SM-ADDED*/
+      break;
+
+    case GSF_FILE:
+    case PFM_FILE:
+    case LLZ_FILE:
+      ctx->eof = 1;
+      break;
+
+    case RDP_FILE:
+      if (ctx->stream != NULL)
         {
-          perror (file[filecount]);
-          exit (-1);
+          /*  Skip the endian word when we slide the window so the records stay aligned.  */
+
+          refill_window (ctx, 0);
+          if (ctx->window_len < (int64_t) sizeof (int32_t))
+            {
+              fprintf (stderr, "\n\nUnable to read RDP header from file %s\n", file);
+              fflush (stderr);
+              reader_close (ctx);
+              return (NULL);
+            }
+
+          memcpy (&endian, ctx->window, sizeof (int32_t));
+          refill_window (ctx, sizeof (int32_t));
+        }
+      else if (ctx->map.size < (int64_t) sizeof (int32_t))
+        {
+          fprintf (stderr, "\n\nUnable to read RDP header from file %s\n", file);
+          fflush (stderr);
+          reader_close (ctx);
+          return (NULL);
         }
+      else
+        {
+          memcpy (&endian, ctx->map.data, sizeof (int32_t));
+          ctx->words = (const uint32_t *) (ctx->map.data + sizeof (int32_t));
+          ctx->map_records = (ctx->map.size - sizeof (int32_t)) / (3 * sizeof (int32_t));
+        }
+
+      if (endian != 0x00010203)
+        {
+          ctx->byte_swap = NVTrue;
+        }
+      else
+        {
+          ctx->byte_swap = NVFalse;
+        }
+      break;
+
+    case HOF_FILE:
+    case TOF_FILE:
+    case LAS_FILE:
+      if (ctx->filetype == HOF_FILE)
+        {
+          hof_read_header (ctx->fileptr, &ctx->hof_head);
+          record_size = sizeof (HYDRO_OUTPUT_T);
+          byte_position = ftello (ctx->fileptr);
+        }
+      else if (ctx->filetype == TOF_FILE)
+        {
+          tof_read_header (ctx->fileptr, &ctx->tof_head);
+          record_size = sizeof (TOPO_OUTPUT_T);
+          byte_position = ftello (ctx->fileptr);
+        }
+      else
+        {
+          if (las_read_header (ctx->fileptr, file, &ctx->las_head))
+            {
+              reader_close (ctx);
+              return (NULL);
+            }
+          record_size = ctx->las_head.record_length;
+          byte_position = ctx->las_head.point_offset;
+        }
+
+
+      /*  The records are fixed length so we can go straight to the first shot in our range.  */
+
+      ctx->num_shots = MAX (ctx->eof - byte_position, 0) / record_size;
+      if (ctx->filetype == LAS_FILE && (int64_t) ctx->las_head.num_points < ctx->num_shots)
+        ctx->num_shots = ctx->las_head.num_points;
+      if (ctx->range.end >= 0 && ctx->range.end < ctx->num_shots) ctx->num_shots = ctx->range.end;
+      ctx->first_shot = ctx->recnum = MIN (ctx->range.start, ctx->num_shots);
+
+      fseeko (ctx->fileptr, byte_position + ctx->first_shot * record_size, SEEK_SET);
+      break;
+
+    case YXZ_FILE:
+    case XYZ_FILE:
+      if (ctx->stream != NULL)
+        {
+          refill_window (ctx, 0);
+          break;
+        }
+
 
-      *filetype = LLZ_FILE;
+      /*  If we're starting in the middle of the file, the partial line we land in belongs to the previous range.  Lines
+          that start before the end of our range are ours even if they run past it.  */
+
+      if (ctx->range.end < 0 || ctx->range.end > ctx->map.size) ctx->range.end = ctx->map.size;
+      if (ctx->range.start > ctx->range.end) ctx->range.start = ctx->range.end;
+
+      ctx->text = (const char *) ctx->map.data + ctx->range.start;
+      ctx->text_end = (const char *) ctx->map.data + ctx->range.end;
+
+      if (ctx->range.start > 0 && ctx->text[-1] != '\n')
+        ctx->text = ascii_next_line (ctx->text, (const char *) ctx->map.data + ctx->map.size);
+      break;
     }
-  else if (strstr (file[filecount], ".dpg") != NULL)
+
+  return (ctx);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_close                                        *
+*                                                                           *
+*   Purpose:            Close the input file and free the reader context.   *
+*                                                                           *
+\***************************************************************************/
+
+void reader_close (READER_CONTEXT *ctx)
+{
+  if (ctx == NULL) return;
+
+  LOCK_LIBRARY (ctx->filetype);
+
+  if (ctx->filetype == GSF_FILE)
     {
-      *filetype = DPG_FILE;
+      if (ctx->handle >= 0)
+        {
+          gsfFree (&ctx->gsf_records);
+          gsfClose (ctx->handle);
+        }
     }
-  else if (strstr (file[filecount], ".rdp") != NULL)
+  else if (ctx->filetype == PFM_FILE)
     {
-      *filetype = RDP_FILE;
+      if (ctx->handle >= 0) close_pfm_file (ctx->handle);
     }
-  else if (strstr (file[filecount], ".hof") != NULL)
+  else if (ctx->filetype == LLZ_FILE)
     {
-      *filetype = HOF_FILE;
+      if (ctx->handle >= 0) close_llz (ctx->handle);
     }
-  else if (strstr (file[filecount], ".tof") != NULL)
+  else if (ctx->filetype == DPG_FILE || ctx->filetype == RDP_FILE || ctx->filetype == YXZ_FILE ||
+           ctx->filetype == XYZ_FILE || ctx->filetype == CH2P_FILE)
     {
-      *filetype = TOF_FILE;
+      if (ctx->stream != NULL)
+        {
+          decompress_close (ctx->stream);
+        }
+      else
+        {
+          unmap_file (&ctx->map);
+        }
     }
-  else if (strstr (file[filecount], ".txt") != NULL || strstr (file[filecount], ".yxz") != NULL || 
-           strstr (file[filecount], ".raw") != NULL)
+  else
     {
-      *filetype = YXZ_FILE;
+      if (ctx->fileptr != NULL) fclose (ctx->fileptr);
     }
-  else if (strstr (file[filecount], ".xyz") != NULL)
+
+  UNLOCK_LIBRARY (ctx->filetype);
+
+  if (ctx->bin_row) free (ctx->bin_row);
+  if (ctx->row_depth) free (ctx->row_depth);
+  if (ctx->row_x) free (ctx->row_x);
+  if (ctx->row_y) free (ctx->row_y);
+  if (ctx->row_z) free (ctx->row_z);
+  if (ctx->swap_buffer) free (ctx->swap_buffer);
+  if (ctx->record_buffer) free (ctx->record_buffer);
+  if (ctx->beam_y) free (ctx->beam_y);
+  if (ctx->beam_x) free (ctx->beam_x);
+  if (ctx->valid) free (ctx->valid);
+  if (ctx->window) free (ctx->window);
+  free (ctx->filename);
+  free (ctx);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_percent                                      *
+*                                                                           *
+*   Purpose:            Return the percentage of the file that has been     *
+*                       read as of the last call to reader_read.            *
+*                                                                           *
+\***************************************************************************/
+
+int32_t reader_percent (READER_CONTEXT *ctx)
+{
+  return (ctx->percent);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_is_pipe                                      *
+*                                                                           *
+*   Purpose:            Check whether an input file name is standard input  *
+*                       or a named pipe (see decompress.h).  Pipes can't    *
+*                       report a percentage so callers should show the      *
+*                       number of points read instead.                      *
+*                                                                           *
+\***************************************************************************/
+
+uint8_t reader_is_pipe (char *file)
+{
+  return (decompress_is_pipe (file));
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_prefetch                                     *
+*                                                                           *
+*   Purpose:            Ask the kernel to start reading the first           *
+*                       READER_PREFETCH_BYTES of a file into the page cache *
+*                       (posix_fadvise WILLNEED returns right away) so it's *
+*                       there when we open it for real.  Pipes are left     *
+*                       alone.  This does nothing on Windows.               *
+*                                                                           *
+\***************************************************************************/
+
+void reader_prefetch (char *file)
+{
+#ifndef NVWIN3X
+  int32_t              fd;
+
+
+  if (decompress_is_pipe (file)) return;
+
+  if ((fd = open (file, O_RDONLY)) < 0) return;
+
+  posix_fadvise (fd, 0, READER_PREFETCH_BYTES, POSIX_FADV_WILLNEED);
+
+  close (fd);
+#endif
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_culled                                       *
+*                                                                           *
+*   Purpose:            Return the number of GSF pings that were skipped    *
+*                       because their swath was outside of the area.        *
+*                                                                           *
+\***************************************************************************/
+
+int64_t reader_culled (READER_CONTEXT *ctx)
+{
+  return (ctx->culled);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_block_alloc, reader_block_free               *
+*                                                                           *
+*   Purpose:            Allocate and free the point blocks that are         *
+*                       filled by reader_read.                              *
+*                                                                           *
+\***************************************************************************/
+
+READER_BLOCK *reader_block_alloc (int32_t size)
+{
+  READER_BLOCK         *block;
+
+
+  block = (READER_BLOCK *) calloc (1, sizeof (READER_BLOCK));
+  if (block == NULL)
     {
-      *filetype = XYZ_FILE;
+      perror ("Allocating reader block");
+      exit (-1);
     }
-  else if (strstr (file[filecount], ".pfm") != NULL)
+
+  block->x = (double *) malloc (size * sizeof (double));
+  block->y = (double *) malloc (size * sizeof (double));
+  block->z = (double *) malloc (size * sizeof (double));
+
+  if (block->x == NULL || block->y == NULL || block->z == NULL)
     {
-      open_args.checkpoint = 0;
-      strcpy (open_args.list_path, file[filecount]);
+      perror ("Allocating reader block arrays");
+      exit (-1);
+    }
 
-      *handle = open_existing_pfm_file (&open_args);
+  block->size = size;
+  block->count = 0;
 
-      if (*handle < 0) pfm_error_exit (pfm_error);
+  return (block);
+}
 
-      *filetype = PFM_FILE;
-    }
-  else
+
+void reader_block_free (READER_BLOCK *block)
+{
+  if (block == NULL) return;
+
+  free (block->x);
+  free (block->y);
+  free (block->z);
+  free (block);
+}
+
+
+
+/*  Make sure the HOF/TOF/LLZ record buffer holds at least size bytes.  */
+
+static void *record_buffer (READER_CONTEXT *ctx, int64_t size)
+{
+  if (size > ctx->record_buffer_size)
     {
-      if (gsfOpen(file[filecount], GSF_READONLY, handle) == -1)
+      ctx->record_buffer_size = size;
+      ctx->record_buffer = realloc (ctx->record_buffer, size);
+      if (ctx->record_buffer == NULL)
         {
-          fprintf (stderr, "\n\nUnable to open file %s\n", file[filecount]);
-          gsfPrintError (stderr);
+          perror ("Allocating record buffer");
           exit (-1);
         }
-      *filetype = GSF_FILE;
     }
 
+  return (ctx->record_buffer);
+}
+
+
+
+/*  Read a block of count HOF or TOF records.  The records are stored little endian and fixed length on disk so, on
+    little endian systems, we read the whole block with one fread instead of an fread per shot.  On big endian systems
+    we let hof_read_record/tof_read_record swap them for us.  Returns the number of records read.  */
+
+static int64_t read_shots (READER_CONTEXT *ctx, void *records, int64_t count)
+{
+  int64_t              i;
+
+
+  if (!big_endian ())
+    {
+      if (ctx->filetype == HOF_FILE) return (fread (records, sizeof (HYDRO_OUTPUT_T), count, ctx->fileptr));
+      return (fread (records, sizeof (TOPO_OUTPUT_T), count, ctx->fileptr));
+    }
 
-  if (*filetype != GSF_FILE && *filetype != PFM_FILE && *filetype != LLZ_FILE)
+  for (i = 0 ; i < count ; i++)
     {
-      if (*filetype == HOF_FILE)
-        {
-          if ((*fileptr = open_hof_file (file[filecount])) == NULL)
-            {
-              perror(file[filecount]);
-              exit(-1);
-            }
-        }
-      else if (*filetype == TOF_FILE)
+      if (ctx->filetype == HOF_FILE)
         {
-          if ((*fileptr = open_tof_file (file[filecount])) == NULL)
-            {
-              perror(file[filecount]);
-              exit(-1);
-            }
+          if (!hof_read_record (ctx->fileptr, HOF_NEXT_RECORD, &((HYDRO_OUTPUT_T *) records)[i])) break;
         }
       else
         {
-          /* Open the input file.  */
-
-          if ((*fileptr = fopen (file[filecount], "r")) == NULL)
-            {
-              perror(file[filecount]);
-              exit(-1);
-            }
+          if (!tof_read_record (ctx->fileptr, TOF_NEXT_RECORD, &((TOPO_OUTPUT_T *) records)[i])) break;
         }
     }
 
-
-  filecount++;
-
-  prev_filetype = *filetype;
-
-  return (0);
+  return (i);
 }
 
 
 
-int32_t reader (NV_F64_COORD3 *xyz, int32_t date_line, char *file[], int32_t numfiles, uint8_t nominal)
+/*  Read one row of PFM bins.  The bin records for the whole row come from one read_bin_row call, the soundings for
+    every bin in the row are gathered into row_depth (which is only grown, never freed, between rows), and then one
+    pass over row_depth drops the invalid, deleted, and reference soundings and splits the rest into row_x, row_y, and
+    row_z for reader_read to copy into blocks.  */
+
+static void pfm_read_row (READER_CONTEXT *ctx)
 {
-  static FILE          *fileptr = NULL;
-  static int32_t       firstfile = 1, filetype = 0, recnum = 0, old_percent = -1, eof, 
-                       handle, beam_num = -1, total_beams, row = 0, col = 0, rec = 0, numrecs = 0;
-  char                 string[256], cut[50];
-  int32_t              status, rdp_record[3], endian, year, day, hour, minute, percent, 
-                       byte_position = 0, latdeg, londeg, latmin, lonmin;
-  float                dpg_record[3], second, dep, dep2;
-  double               lateral, lat1, lon1, lat2, lon2, latsec, lonsec;
-  static double        nlat, nlon, ang1, ang2;
-  static BIN_RECORD    bin;
-  static DEPTH_RECORD  *depth_record = NULL;
   NV_I32_COORD2        coord;
-  int32_t              llz_handle = 0;
-  LLZ_REC              llz_rec;
-  HYDRO_OUTPUT_T       hof;
-  HOF_HEADER_T         hof_head;
-  TOPO_OUTPUT_T        tof;
-  TOF_HEADER_T         tof_head;
-  static gsfDataID     gsf_data_id;
-  static gsfRecords    gsf_records;
-  static uint8_t       byte_swap = NVFalse, bad, just_opened = NVFalse;
+  DEPTH_RECORD         *depth;
+  int32_t              col, numrecs, status;
+  int64_t              i, total, count;
 
 
+  ctx->row_points = ctx->row_pos = 0;
 
-  void newgp (double, double, double, double, double *, double *);
-  uint8_t checkinput (FILE *dpgptr);
+  LOCK_READ (PFM_FILE);
+  status = read_bin_row (ctx->handle, ctx->num_cols, ctx->row, ctx->first_col, ctx->bin_row);
+  UNLOCK_READ (PFM_FILE);
 
+  if (status) return;
 
 
+  /*  Gather the soundings.  */
 
-  bad = NVTrue;
+  total = 0;
+  coord.y = ctx->row;
 
-  while (bad)
+  for (col = 0 ; col < ctx->num_cols ; col++)
     {
-      if (filetype != GSF_FILE && filetype != PFM_FILE && filetype != LLZ_FILE && fileptr != NULL) 
-        byte_position = ftell (fileptr);
+      if (!ctx->bin_row[col].num_soundings) continue;
 
+      coord.x = ctx->first_col + col;
+      depth = NULL;
 
-      /*  If byte_position is less than zero this is the first file, otherwise, check if current file is finished 
-          processing and open a file.    */
+      LOCK_READ (PFM_FILE);
+      status = read_depth_array_index (ctx->handle, coord, &depth, &numrecs);
+      UNLOCK_READ (PFM_FILE);
 
-      if (byte_position < 0 || byte_position >= eof || (filetype != GSF_FILE && filetype != PFM_FILE && 
-                                                        filetype != LLZ_FILE && fileptr == NULL))
+      if (status || depth == NULL)
         {
-          recnum = 0;
-          firstfile = openfile (file, numfiles, &fileptr, &filetype, &handle);
-          if (firstfile)
-            {
-              printf ("\n\n\n");
-              return (1);
-            }
+          if (depth) free (depth);
+          continue;
+        }
 
-          if (filetype != GSF_FILE && filetype != PFM_FILE && filetype != LLZ_FILE)
+      if (total + numrecs > ctx->row_depth_size)
+        {
+          ctx->row_depth_size = MAX (2 * ctx->row_depth_size, total + numrecs);
+          ctx->row_depth = (DEPTH_RECORD *) realloc (ctx->row_depth, ctx->row_depth_size * sizeof (DEPTH_RECORD));
+          if (ctx->row_depth == NULL)
             {
-              byte_position = ftell (fileptr);
-              fseek (fileptr, 0, SEEK_END);
-              eof = ftell (fileptr);
-              fseek (fileptr, byte_position, 0);
+              perror ("Allocating PFM row buffer");
+              exit (-1);
             }
+        }
 
-          switch (filetype)
-            {
-            case DPG_FILE:
-              byte_swap = checkinput(fileptr);			/*SM-ADDED*/
-              fseek(fileptr,0,SEEK_SET);
-              break;
-    
-            case GSF_FILE:
-            case PFM_FILE:
-            case LLZ_FILE:
-              eof = 1;
-              break;
-    
-            case RDP_FILE:
-              if (!fread (&endian, 4, 1, fileptr))
-		{
-		  fprintf (stderr, "Bad return in file %s, function %s at line %d.  This should never happen!", __FILE__, __FUNCTION__, __LINE__ - 2);
-		  fflush (stderr);
-		  exit (-1);
-		}
-              if (endian != 0x00010203)
-                {
-                  byte_swap = NVTrue;
-                }
-              else
-                {
-                  byte_swap = NVFalse;
-                }
-              break;
-    
-    
-            case HOF_FILE:
-              hof_read_header (fileptr, &hof_head);
-              break;
-                
-    
-            case TOF_FILE:
-              tof_read_header (fileptr, &tof_head);
-              break;
-                
+      memcpy (&ctx->row_depth[total], depth, numrecs * sizeof (DEPTH_RECORD));
+      total += numrecs;
 
-            case YXZ_FILE:
-            case XYZ_FILE:
-              break;
-            }
-          just_opened = NVTrue;
+      free (depth);
+    }
+
+
+  if (total > ctx->row_size)
+    {
+      ctx->row_size = ctx->row_depth_size;
+      ctx->row_x = (double *) realloc (ctx->row_x, ctx->row_size * sizeof (double));
+      ctx->row_y = (double *) realloc (ctx->row_y, ctx->row_size * sizeof (double));
+      ctx->row_z = (double *) realloc (ctx->row_z, ctx->row_size * sizeof (double));
+      if (ctx->row_x == NULL || ctx->row_y == NULL || ctx->row_z == NULL)
+        {
+          perror ("Allocating PFM row points");
+          exit (-1);
         }
+    }
 
-      bad = NVFalse;
 
+  /*  Validity mask pass.  */
+
+  count = 0;
+  for (i = 0 ; i < total ; i++)
+    {
+      ctx->row_x[count] = ctx->row_depth[i].xyz.x;
+      ctx->row_y[count] = ctx->row_depth[i].xyz.y;
+      ctx->row_z[count] = ctx->row_depth[i].xyz.z;
+      count += !(ctx->row_depth[i].validity & (PFM_INVAL | PFM_DELETED | PFM_REFERENCE));
+    }
+
+  ctx->row_points = count;
+}
+
+
+
+/*  Add a single point to the block.  The callers check that there is room.  */
+
+#define ADD_POINT(blk, px, py, pz) \
+  { \
+    (blk)->x[(blk)->count] = (px); \
+    (blk)->y[(blk)->count] = (py); \
+    (blk)->z[(blk)->count] = (pz); \
+    (blk)->count++; \
+  }
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        reader_read                                         *
+*                                                                           *
+*   Purpose:            Fill a block of points from an open input file.     *
+*                       This keeps reading until the block is full or we    *
+*                       run out of data.  Piped input is the exception.     *
+*                       Once we've parsed everything that has arrived we    *
+*                       return the points we have instead of waiting for    *
+*                       more.  Progress is only computed once per block     *
+*                       instead of once per point.                          *
+*                                                                           *
+*   Inputs:             ctx             -   context from reader_open        *
+*                       block           -   caller allocated block (see     *
+*                                           reader_block_alloc)             *
+*                                                                           *
+*   Outputs:            int32_t         -   1 on end of file (the block     *
+*                                           will be empty), otherwise 0     *
+*                                                                           *
+\***************************************************************************/
 
-      /* Input a record from the current file being processed.        */
+int32_t reader_read (READER_CONTEXT *ctx, READER_BLOCK *block)
+{
+  int32_t              i, status;
+  int64_t              j, n;
+  const char           *next, *text_end;
+  const uint32_t       *words;
+  const float          *dpg_record;
+  const int32_t        *rdp_record;
+  double               x, y, z;
+  LLZ_REC              *llz_recs;
+  HYDRO_OUTPUT_T       *hof_shots;
+  TOPO_OUTPUT_T        *tof_shots;
+  uint8_t              *las_records;
+  NV_F64_MBR           bounds;
+  gsfSwathBathyPing    *ping;
+  uint8_t              partial = NVFalse;
+
+
+
+  block->count = 0;
+
+  while (!ctx->file_done && !partial && block->count < block->size)
+    {
+      /* Input a record from the current file being processed.  Every branch sets file_done when it runs out of
+         data instead of comparing ftell against the end of file for every record.  */
 
-      switch (filetype)
+      switch (ctx->filetype)
         {
         case LLZ_FILE:
 
-          if (read_llz (llz_handle, LLZ_NEXT_RECORD, &llz_rec))
-            {
-              byte_position = 0;
+          /*  Pull as many records as will fit in the block with one trip through the library lock.  */
 
-              xyz->y = llz_rec.xy.lat;
-              xyz->x = llz_rec.xy.lon;
-              xyz->z = llz_rec.depth;
+          n = MIN ((int64_t) ctx->llz_header.number_of_records - ctx->recnum, (int64_t) (block->size - block->count));
+          llz_recs = (LLZ_REC *) record_buffer (ctx, n * sizeof (LLZ_REC));
 
-              if (llz_rec.status & LLZ_INVAL) bad = NVTrue;
+          LOCK_READ (LLZ_FILE);
+          for (j = 0 ; j < n ; j++)
+            {
+              if (!read_llz (ctx->handle, LLZ_NEXT_RECORD, &llz_recs[j])) break;
             }
-          else
+          UNLOCK_READ (LLZ_FILE);
+
+          if (j < n || n <= 0) ctx->file_done = NVTrue;
+
+          n = j;
+          ctx->recnum += n;
+
+          for (j = 0 ; j < n ; j++)
             {
-              byte_position = -1;
-              bad = NVTrue;
+              block->x[block->count] = llz_recs[j].xy.lon;
+              block->y[block->count] = llz_recs[j].xy.lat;
+              block->z[block->count] = llz_recs[j].depth;
+              block->count += !(llz_recs[j].status & LLZ_INVAL);
             }
           break;
 
 
         case DPG_FILE:
+        case RDP_FILE:
 
-          status = fread (dpg_record, sizeof (dpg_record), 1, fileptr);
+          /*  Work on as many records as will fit in what's left of the block.  Unless we have to byte swap we read
+              straight out of the mapped file.  The byte swap and the all zero record check each make one pass over
+              the whole chunk.  */
 
- 
-          if(byte_swap)				/*SM-ADDED*/
+          if (ctx->stream != NULL && ctx->map_pos == ctx->map_records && !ctx->stream_done)
             {
-              swap_float(&dpg_record[0]);
-              swap_float(&dpg_record[1]);
-              swap_float(&dpg_record[2]);
-            }					/*SM-ADDED*/
+              if (ctx->stream_pipe && block->count)
+                {
+                  partial = NVTrue;
+                  break;
+                }
 
-          if ((dpg_record[0] == 0.0 && dpg_record[1] == 0.0 && dpg_record[2] == 0.0) || status <= 0)
-            {
-              bad = NVTrue;
+              refill_window (ctx, ctx->map_pos * 3 * sizeof (uint32_t));
             }
-          else
+
+          n = MIN (ctx->map_records - ctx->map_pos, (int64_t) (block->size - block->count));
+
+          if (n <= 0)
             {
-              xyz->y = dpg_record[0];
-              xyz->x = dpg_record[1];
-              xyz->z = dpg_record[2];
+              ctx->file_done = NVTrue;
+              break;
             }
-          break;
 
+          if (ctx->scratch_size < block->size)
+            {
+              ctx->swap_buffer = (uint32_t *) realloc (ctx->swap_buffer, block->size * 3 * sizeof (uint32_t));
+              ctx->valid = (uint8_t *) realloc (ctx->valid, block->size * sizeof (uint8_t));
 
-        case RDP_FILE:
+              if (ctx->swap_buffer == NULL || ctx->valid == NULL)
+                {
+                  perror ("Allocating DPG/RDP buffers");
+                  exit (-1);
+                }
+
+              ctx->scratch_size = block->size;
+            }
+
+          words = ctx->words + ctx->map_pos * 3;
 
-          status = fread (rdp_record, sizeof (rdp_record), 1, fileptr);
+          if (ctx->byte_swap)				/*SM-ADDED*/
+            {
+              swap_words (ctx->swap_buffer, words, n * 3);
+              words = ctx->swap_buffer;
+            }
 
-          if (byte_swap) swap_rdp (rdp_record);
 
-          if ((rdp_record[0] == 0 && rdp_record[1] == 0 && rdp_record[2] == 0) || status <= 0)
+          if (ctx->filetype == DPG_FILE)
             {
-              bad = NVTrue;
+              nonzero_records (words, n, 0x7fffffff, ctx->valid);
+
+              dpg_record = (const float *) words;
+
+              for (j = 0 ; j < n ; j++)
+                {
+                  if (ctx->valid[j]) ADD_POINT (block, dpg_record[j * 3 + 1], dpg_record[j * 3], dpg_record[j * 3 + 2]);
+                }
             }
           else
             {
-              xyz->y = rdp_record[0] / 10000000.0;
-              xyz->x = rdp_record[1] / 10000000.0;
-              xyz->z = rdp_record[2] / 10000.0;
+              nonzero_records (words, n, 0xffffffff, ctx->valid);
+
+              rdp_record = (const int32_t *) words;
+
+              for (j = 0 ; j < n ; j++)
+                {
+                  if (ctx->valid[j]) ADD_POINT (block, rdp_record[j * 3 + 1] / 10000000.0, rdp_record[j * 3] / 10000000.0,
+                                                rdp_record[j * 3 + 2] / 10000.0);
+                }
             }
+
+          ctx->map_pos += n;
           break;
 
 
         case HOF_FILE:
-          hof_read_record (fileptr, HOF_NEXT_RECORD, &hof);
+
+          n = MIN (ctx->num_shots - ctx->recnum, (int64_t) (block->size - block->count));
+          hof_shots = (HYDRO_OUTPUT_T *) record_buffer (ctx, n * sizeof (HYDRO_OUTPUT_T));
+
+          if (n <= 0 || !(n = read_shots (ctx, hof_shots, n)))
+            {
+              ctx->file_done = NVTrue;
+              break;
+            }
+
+          ctx->recnum += n;
 
 
           /*  HOF uses the lower three bits of the status field for status thusly :
@@ -496,379 +1658,355 @@ int32_t reader (NV_F64_COORD3 *xyz, int32_t date_line, char *file[], int32_t num
           bit 1 = kept       (2) 
           bit 2 = swapped    (4)      */
 
-          if ((hof.status & AU_STATUS_DELETED_BIT) || (hof.abdc < 70) || (hof.correct_depth == -998.0))
-            {
-              bad = NVTrue;
-            }
-          else
+          for (j = 0 ; j < n ; j++)
             {
-              xyz->y = hof.latitude;
-              xyz->x = hof.longitude;
-              xyz->z = -hof.correct_depth;
+              block->x[block->count] = hof_shots[j].longitude;
+              block->y[block->count] = hof_shots[j].latitude;
+              block->z[block->count] = -hof_shots[j].correct_depth;
+              block->count += !((hof_shots[j].status & AU_STATUS_DELETED_BIT) || (hof_shots[j].abdc < 70) ||
+                                (hof_shots[j].correct_depth == -998.0));
             }
           break;
 
 
         case TOF_FILE:
-          tof_read_record (fileptr, TOF_NEXT_RECORD, &tof);
+
+          n = MIN (ctx->num_shots - ctx->recnum, (int64_t) (block->size - block->count));
+          tof_shots = (TOPO_OUTPUT_T *) record_buffer (ctx, n * sizeof (TOPO_OUTPUT_T));
+
+          if (n <= 0 || !(n = read_shots (ctx, tof_shots, n)))
+            {
+              ctx->file_done = NVTrue;
+              break;
+            }
+
+          ctx->recnum += n;
 
 
           /*  TOF uses the lower two bits of the status field for status thusly :
               bit 0 = first deleted    (1) 
               bit 1 = second deleted   (2) */
 
-          if (tof.elevation_last == -998.0 || tof.conf_last < 50)
-            {
-              bad = NVTrue;
-            }
-          else
+          for (j = 0 ; j < n ; j++)
             {
-              xyz->y = tof.latitude_last;
-              xyz->x = tof.longitude_last;
-              xyz->z = -tof.elevation_last;
+              block->x[block->count] = tof_shots[j].longitude_last;
+              block->y[block->count] = tof_shots[j].latitude_last;
+              block->z[block->count] = -tof_shots[j].elevation_last;
+              block->count += !(tof_shots[j].elevation_last == -998.0 || tof_shots[j].conf_last < 50);
             }
           break;
 
 
+        case LAS_FILE:
 
-        case YXZ_FILE:
+          /*  Read as many point records as will fit in what's left of the block and decode them in one pass (see
+              las.c).  */
 
+          n = MIN (ctx->num_shots - ctx->recnum, (int64_t) (block->size - block->count));
+          las_records = (uint8_t *) record_buffer (ctx, n * ctx->las_head.record_length);
 
-          /********************************************************************
-           *
-           * Description : Reads a Hypack yxz file in the following format:
-           *
-           *                DDD-MM-SS.SSSs,DDD-MM-SS.SSSs,DD.DDD
-           *
-           *               Example:
-           *
-           *                013-27-18.771N,144-37-41.383E,53.230
-           *
-           *               Last field is not fixed size so we can only read these
-           *               not update (like I care).
-           *
-           *               Or it will read files derived from Hypack RAW files that
-           *               are in the following format:
-           *
-           * YEAR DAY HH:MM:SS.SSSS   DD.ddddddddd  DDD.ddddddddd   depth   depth   depth
-           * 2001 017 03:25:10.0620   13.430910402  144.660955271    7.06    8.77    8.02
-           *
-           *                All fields that start with a # are comments.  Third depth is
-           *                tide corrected.
-           *
-           *               Or it will read YXZ files in the following formats:
-           *
-           * [signed] lat degrees decimal  [signed] lon degrees decimal  depth
-           *
-           *               or
-           *
-           * [signed] lat degrees decimal,[signed] lon degrees decimal,depth
-           *
-           *               Example:
-           *
-           *                21.000278 -157.619722 223
-           *
-           *               or
-           *
-           *                21.000278,-157.619722,223
-           *
-           ********************************************************************/
-
-          if (fgets (string, sizeof (string), fileptr) == NULL)
-	    {
-	      fprintf (stderr, "Bad return in file %s, function %s at line %d.  This should never happen!", __FILE__, __FUNCTION__, __LINE__ - 2);
-	      fflush (stderr);
-	      exit (-1);
-	    }
-
-          if (string[0] == '#')
-            {
-              bad = NVTrue;
-            }
-          else
+          if (n <= 0 || !(n = fread (las_records, ctx->las_head.record_length, n, ctx->fileptr)))
             {
-              if (strchr (string, ':'))
-                {
-                  sscanf (string, "%d %d %d:%d:%f %lf %lf %f %f %lf", &year, &day, &hour, &minute, &second, &xyz->y, 
-                          &xyz->x, &dep, &dep2, &xyz->z);
-                }
-              else if (string[3] == '-' && string[7] == '-')
-                {
-                  strncpy (cut, &string[1], 13);
-                  cut[13] = 0;
-                  sscanf (cut, "%03d-%02d-%lf", &latdeg, &latmin, &latsec);
+              ctx->file_done = NVTrue;
+              break;
+            }
 
-                  strncpy (cut, &string[16], 13);
-                  cut[13] = 0;
-                  sscanf (cut, "%03d-%02d-%lf", &londeg, &lonmin, &lonsec);
+          ctx->recnum += n;
 
-                  strcpy (cut, &string[31]);
-                  sscanf (cut, "%lf", &xyz->z);
+          block->count += las_decode (&ctx->las_head, las_records, n, ctx->options.las_skip, &block->x[block->count],
+                                      &block->y[block->count], &block->z[block->count]);
+          break;
 
 
-                  xyz->y = (double) latdeg + (double) latmin / 60.0 + latsec / 3600.0;
-                  if (strchr (string, 'S')) xyz->y = -(xyz->y);
-                  xyz->x = (double) londeg + (double) lonmin / 60.0 + lonsec / 3600.0;
-                  if (strchr (string, 'W')) xyz->x = -(xyz->x);
-                }
-              else
+
+        case YXZ_FILE:
+        case XYZ_FILE:
+
+          /*  See ascii.c for the formats.  */
+
+          if (ctx->stream != NULL)
+            {
+              if (ctx->text >= ctx->text_end && !ctx->stream_done)
                 {
-                  if (strchr (string, ','))
-                    {
-                      sscanf (string, "%lf,%lf,%lf", &xyz->y, &xyz->x, &xyz->z);
-                    }
-                  else
+                  if (ctx->stream_pipe && block->count)
                     {
-                      sscanf (string, "%lf %lf %lf", &xyz->y, &xyz->x, &xyz->z);
+                      partial = NVTrue;
+                      break;
                     }
-                }
-            }
-          break;
-
-
-        case XYZ_FILE:
 
+                  refill_window (ctx, ctx->text - (const char *) ctx->window);
+                }
 
-          /********************************************************************
-           *
-           *         All fields that start with a # are comments.
-           *
-           *         Will read XYZ files in the following formats:
-           *
-           * [signed] lon degrees decimal  [signed] lat degrees decimal  depth
-           *
-           *               or
-           *
-           * [signed] lon degrees decimal,[signed] lat degrees decimal,depth
-           *
-           *               Example:
-           *
-           *                -157.619722 21.000278 223.5
-           *
-           *               or
-           *
-           *                -157.619722,21.000278,223.5
-           *
-           ********************************************************************/
-
-          if (fgets (string, sizeof (string), fileptr) == NULL)
-	    {
-	      fprintf (stderr, "Bad return in file %s, function %s at line %d.  This should never happen!", __FILE__, __FUNCTION__, __LINE__ - 2);
-	      fflush (stderr);
-	      exit (-1);
-	    }
-
-          if (string[0] == '#')
-            {
-              bad = NVTrue;
+              text_end = ctx->text_end;
             }
           else
             {
-              if (strchr (string, ','))
-                {
-                  sscanf (string, "%lf,%lf,%lf", &xyz->x, &xyz->y, &xyz->z);
-                }
-              else
-                {
-                  sscanf (string, "%lf %lf %lf", &xyz->x, &xyz->y, &xyz->z);
-                }
+              text_end = (const char *) ctx->map.data + ctx->map.size;
+            }
+
+          while (ctx->text < ctx->text_end && block->count < block->size)
+            {
+              next = ascii_next_line (ctx->text, text_end);
+
+              if (ascii_parse_line (ctx->text, (next < text_end || next[-1] == '\n') ? next - 1 : next, ctx->filetype,
+                                    &x, &y, &z)) ADD_POINT (block, x, y, z);
+
+              ctx->text = next;
             }
+
+          if (ctx->text >= ctx->text_end && (ctx->stream == NULL || ctx->stream_done)) ctx->file_done = NVTrue;
           break;
 
 
         case GSF_FILE:
 
-          bad = NVTrue;
-          byte_position = 0;
+          ping = &ctx->gsf_records.mb_ping;
 
-          if (beam_num == -1)
+          if (ctx->beam_num == -1)
             {
-              status = gsfRead (handle, GSF_RECORD_SWATH_BATHYMETRY_PING, &gsf_data_id, &gsf_records, NULL, 0);
+              if (ctx->gsf_direct)
+                {
+                  if (ctx->gsf_ping > ctx->gsf_last_ping)
+                    {
+                      ctx->file_done = NVTrue;
+                      break;
+                    }
+
+                  ctx->gsf_data_id.recordID = GSF_RECORD_SWATH_BATHYMETRY_PING;
+                  ctx->gsf_data_id.record_number = ctx->gsf_ping++;
+                }
+
+              LOCK_READ (GSF_FILE);
+              status = gsfRead (ctx->handle, GSF_RECORD_SWATH_BATHYMETRY_PING, &ctx->gsf_data_id, &ctx->gsf_records, NULL, 0);
+              UNLOCK_READ (GSF_FILE);
 
               if (status == -1)
                 {
-                  byte_position = -1;
+                  ctx->file_done = NVTrue;
                   break;
                 }
 
 
-              nlat = gsf_records.mb_ping.latitude;
-              nlon = gsf_records.mb_ping.longitude;
-              ang1 = gsf_records.mb_ping.heading + 90.0;
-              ang2 = gsf_records.mb_ping.heading;
-
-              total_beams = gsf_records.mb_ping.number_beams;
+              ctx->total_beams = ping->number_beams;
 
 
               /*  If lat is 91 or lon is 181  */
     
-              if (nlat > 90.0 || nlon > 180.0 || (gsf_records.mb_ping.ping_flags & GSF_IGNORE_PING)) break;
+              if (ping->latitude > 90.0 || ping->longitude > 180.0 || (ping->ping_flags & GSF_IGNORE_PING)) break;
 
-              beam_num = 0;
-            }
 
+              /*  Don't bother positioning the beams if none of them can be in the area.  */
 
-          if (!(gsf_records.mb_ping.beam_flags[beam_num] & GSF_IGNORE_BEAM))
-            {
-              if (gsf_records.mb_ping.across_track != NULL)
-                {
-                  lateral = gsf_records.mb_ping.across_track[beam_num];
-                  newgp (nlat, nlon, ang1, lateral, &lat1, &lon1);
-     
-                  xyz->y = lat1;
-                  xyz->x = lon1;
-                }
-              else
+              if (ctx->options.cull && cull_ping (ctx, ping))
                 {
-                  xyz->y = nlat;
-                  xyz->x = nlon;
+                  ctx->culled++;
+                  break;
                 }
 
-    
-              /* if the along track array is present, use it */
 
-              if (gsf_records.mb_ping.along_track != NULL)
+              /*  Position all of the beams in the ping at once.  */
+
+              if (ctx->total_beams > ctx->beam_size)
                 {
-                  lateral = gsf_records.mb_ping.along_track[beam_num];
-                  newgp (lat1, lon1, ang2, lateral, &lat2, &lon2);
-                  xyz->y = lat2;
-                  xyz->x = lon2;
+                  ctx->beam_size = ctx->total_beams;
+                  ctx->beam_y = (double *) realloc (ctx->beam_y, ctx->beam_size * sizeof (double));
+                  ctx->beam_x = (double *) realloc (ctx->beam_x, ctx->beam_size * sizeof (double));
+                  if (ctx->beam_y == NULL || ctx->beam_x == NULL)
+                    {
+                      perror ("Allocating beam positions");
+                      exit (-1);
+                    }
                 }
 
-              if (nominal)
+              geolocate_ping (ping->latitude, ping->longitude, ping->heading, ping->across_track, ping->along_track,
+                              ping->beam_flags, GSF_IGNORE_BEAM, ctx->total_beams, ctx->options.fast_geolocation,
+                              ctx->beam_y, ctx->beam_x);
+
+              ctx->beam_num = 0;
+            }
+
+
+          /*  Unload as many beams from this ping as will fit in the block.  If we fill the block we'll pick up where
+              we left off on the next call.  */
+
+          for ( ; ctx->beam_num < ctx->total_beams && block->count < block->size ; ctx->beam_num++)
+            {
+              i = ctx->beam_num;
+
+              if (ping->beam_flags[i] & GSF_IGNORE_BEAM) continue;
+
+              y = ctx->beam_y[i];
+              x = ctx->beam_x[i];
+
+              if (ctx->options.nominal)
                 {
-                  if (gsf_records.mb_ping.nominal_depth != NULL)
+                  if (ping->nominal_depth != NULL)
                     {
-                      xyz->z = gsf_records.mb_ping.nominal_depth[beam_num];
+                      z = ping->nominal_depth[i];
                     }
                   else
                     {
-                      if (just_opened)
+                      if (ctx->just_opened)
                         {
                           fprintf (stderr, "Nominal depth requested but not available, using true depth               \n\n");
                           fflush (stderr);
-                          just_opened = NVFalse;
+                          ctx->just_opened = NVFalse;
                         }
-                      xyz->z = gsf_records.mb_ping.depth[beam_num];
+                      z = ping->depth[i];
                     }
                 }
               else
                 {
-                  if (gsf_records.mb_ping.depth != NULL)
+                  if (ping->depth != NULL)
                     {
-                      xyz->z = gsf_records.mb_ping.depth[beam_num];
+                      z = ping->depth[i];
                     }
                   else
                     {
-                      if (just_opened)
+                      if (ctx->just_opened)
                         {
                           fprintf (stderr, "True depth requested but not available, using nominal depth\n\n");
                           fflush (stderr);
-                          just_opened = NVFalse;
+                          ctx->just_opened = NVFalse;
                         }
-                      xyz->z = gsf_records.mb_ping.nominal_depth[beam_num];
+                      z = ping->nominal_depth[i];
                     }
                 }
 
-              bad = NVFalse;
+              ADD_POINT (block, x, y, z);
             }
-          beam_num++;
-          if (beam_num == total_beams) beam_num = -1;
+
+          if (ctx->beam_num >= ctx->total_beams) ctx->beam_num = -1;
           break;
 
 
         case PFM_FILE:
 
-          bad = NVTrue;
-          byte_position = 0;
-
-          if (rec == numrecs)
+          if (ctx->row_pos == ctx->row_points)
             {
-              rec = 0;
-              col++;
-
-              if (col >= open_args.head.bin_width)
+              if (ctx->row > ctx->last_row || !ctx->num_cols)
                 {
-                  col = 0;
-                  row++;
-
-                  if (row == open_args.head.bin_height)
-                    {
-                      byte_position = -1;
-                      break;
-                    }
+                  ctx->file_done = NVTrue;
+                  break;
                 }
 
-              coord.y = row;
-              coord.x = col;
+              pfm_read_row (ctx);
+              ctx->row++;
+            }
 
-              read_bin_record_index (handle, coord, &bin);
 
-              if (!bin.num_soundings)
-                {
-                  rec = 0;
-                  numrecs = 0;
-                  break;
-                }
+          /*  Unload as many soundings from this row as will fit in the block.  */
 
-              if (depth_record) free (depth_record);
-              if (read_depth_array_index (handle, coord, &depth_record, &numrecs))
-                {
-                  rec = 0;
-                  numrecs = 0;
-                  break;
-                }
-            }
+          n = MIN (ctx->row_points - ctx->row_pos, (int64_t) (block->size - block->count));
+
+          memcpy (&block->x[block->count], &ctx->row_x[ctx->row_pos], n * sizeof (double));
+          memcpy (&block->y[block->count], &ctx->row_y[ctx->row_pos], n * sizeof (double));
+          memcpy (&block->z[block->count], &ctx->row_z[ctx->row_pos], n * sizeof (double));
+
+          block->count += n;
+          ctx->row_pos += n;
+          break;
+
+
+        case CH2P_FILE:
 
+          /*  Skip the chunks that can't touch the area.  The points in each chunk are close together (see
+              pointfile.h) so most of the chunks outside of the chart get skipped without being touched.  */
 
-          if (!(depth_record[rec].validity & (PFM_INVAL | PFM_DELETED | PFM_REFERENCE)))
+          while (!ctx->chunk_pos && ctx->chunk < ctx->last_chunk)
             {
-              xyz->y = depth_record[rec].xyz.y;
-              xyz->x = depth_record[rec].xyz.x;
-              xyz->z = depth_record[rec].xyz.z;
-              bad = NVFalse;
+              bounds.slat = ctx->pf_chunks[ctx->chunk].min_y;
+              bounds.nlat = ctx->pf_chunks[ctx->chunk].max_y;
+              bounds.wlon = ctx->pf_chunks[ctx->chunk].min_x;
+              bounds.elon = ctx->pf_chunks[ctx->chunk].max_x;
+
+              if (ctx->pf_chunks[ctx->chunk].count && !outside_area (&ctx->options, &bounds)) break;
+
+              ctx->chunk++;
             }
 
-          rec++;
-          break;
-        }
+          if (ctx->chunk >= ctx->last_chunk)
+            {
+              ctx->file_done = NVTrue;
+              break;
+            }
 
+          n = MIN ((int64_t) ctx->pf_chunks[ctx->chunk].count - ctx->chunk_pos, (int64_t) (block->size - block->count));
 
-      recnum++;
+          block->count += pointfile_decode (ctx->pf_head, &ctx->pf_chunks[ctx->chunk], ctx->map.data, ctx->chunk_pos, n,
+                                            &block->x[block->count], &block->y[block->count], &block->z[block->count]);
 
+          ctx->chunk_pos += n;
 
-      if (filetype == GSF_FILE)
-        {
-          percent = gsfPercent (handle);
-        }
-      else if (filetype == PFM_FILE)
-        {
-          percent = ((float) row / (float) open_args.head.bin_height) * 100.0;
-        }
-      else if (filetype == LLZ_FILE)
-        {
-          percent = ((float) recnum / (float) llz_header.number_of_records) * 100.0;
-        }
-      else
-        {
-          byte_position = ftell (fileptr);
-          percent = ((float) byte_position / (float) eof) * 100.0;
+          if (ctx->chunk_pos == (int64_t) ctx->pf_chunks[ctx->chunk].count)
+            {
+              ctx->chunk++;
+              ctx->chunk_pos = 0;
+            }
+          break;
         }
+    }
 
-      if (old_percent != percent)
-        {
-          fprintf (stderr, "%3d%% processed - %15f   \r", percent, xyz->z);
-          fflush (stderr);
-          old_percent = percent;
-        }
+
+  /*  Compute progress once per block.  */
+
+  if (ctx->file_done)
+    {
+      ctx->percent = 100;
+    }
+  else if (ctx->filetype == GSF_FILE && ctx->gsf_direct)
+    {
+      ctx->percent = ((float) (ctx->gsf_ping - ctx->gsf_first_ping) /
+                      (float) (ctx->gsf_last_ping - ctx->gsf_first_ping + 1)) * 100.0;
+    }
+  else if (ctx->filetype == GSF_FILE)
+    {
+      LOCK_READ (GSF_FILE);
+      ctx->percent = gsfPercent (ctx->handle);
+      UNLOCK_READ (GSF_FILE);
+    }
+  else if (ctx->filetype == CH2P_FILE)
+    {
+      ctx->percent = ((double) (ctx->chunk - ctx->first_chunk) / (double) (ctx->last_chunk - ctx->first_chunk)) * 100.0;
+    }
+  else if (ctx->filetype == PFM_FILE)
+    {
+      ctx->percent = ((float) (ctx->row - ctx->first_row) / (float) (ctx->last_row - ctx->first_row + 1)) * 100.0;
+    }
+  else if (ctx->filetype == LLZ_FILE)
+    {
+      ctx->percent = ((double) ctx->recnum / (double) ctx->llz_header.number_of_records) * 100.0;
+    }
+  else if (ctx->stream != NULL)
+    {
+      ctx->percent = decompress_percent (ctx->stream);
+    }
+  else if (ctx->filetype == DPG_FILE || ctx->filetype == RDP_FILE)
+    {
+      ctx->percent = ((double) ctx->map_pos / (double) ctx->map_records) * 100.0;
+    }
+  else if (ctx->filetype == YXZ_FILE || ctx->filetype == XYZ_FILE)
+    {
+      ctx->percent = ((double) (ctx->text - ((const char *) ctx->map.data + ctx->range.start)) /
+                      (double) (ctx->range.end - ctx->range.start)) * 100.0;
+    }
+  else
+    {
+      ctx->percent = ((double) (ctx->recnum - ctx->first_shot) / (double) (ctx->num_shots - ctx->first_shot)) * 100.0;
     }
 
 
+  if (!block->count) return (1);
+
+
   /* Check if the chart crosses over the date line.              */
 
-  if ((date_line) && (xyz->x < 0.0))
+  if (ctx->options.date_line)
     {
-      xyz->x += 360.0;
+      for (i = 0 ; i < block->count ; i++)
+        {
+          if (block->x[i] < 0.0) block->x[i] += 360.0;
+        }
     }
 
   return (0);
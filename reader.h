@@ -0,0 +1,167 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+#ifndef __CHRTR2_READER_H__
+#define __CHRTR2_READER_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+
+
+/*  Input file types.  */
+
+#define         LLZ_FILE        0
+#define         DPG_FILE        1
+#define         RDP_FILE        2
+#define         HOF_FILE        3
+#define         TOF_FILE        4
+#define         GSF_FILE        5
+#define         YXZ_FILE        6
+#define         XYZ_FILE        7
+#define         PFM_FILE        8
+#define         LAS_FILE        9
+#define         CH2P_FILE       10          /*  chrtr2 point file (see pointfile.h)  */
+
+
+/*  Number of points that reader_read will try to return on each call.  */
+
+#define         READER_BLOCK_SIZE       32768
+
+
+/*  Block of points returned by reader_read.  This is a structure of arrays so that the caller can run over each
+    coordinate in a tight loop.  Positions are in degrees, Z is positive down.  */
+
+typedef struct
+{
+  double        *x;                         /*  Longitudes  */
+  double        *y;                         /*  Latitudes  */
+  double        *z;                         /*  Z values  */
+  int32_t       count;                      /*  Number of points currently in the block  */
+  int32_t       size;                       /*  Number of points the arrays will hold  */
+} READER_BLOCK;
+
+
+/*  YXZ and XYZ files bigger than twice this are split into this size chunks so they can be read by more than one
+    thread.  */
+
+#define         READER_ASCII_CHUNK      (64 * 1024 * 1024)
+
+
+/*  GSF files with at least twice this many pings are split into ranges of this many pings.  */
+
+#define         READER_GSF_PINGS        10000
+
+
+/*  GSF files smaller than this are never split.  Splitting needs the GSF index and building that means reading the
+    whole file.  */
+
+#define         READER_GSF_SPLIT_SIZE   (128 * 1024 * 1024)
+
+
+/*  HOF and TOF files with at least twice this many shots are split into ranges of this many shots.  If there are
+    fewer files than decoder threads (see min_ranges in READER_OPTIONS) the ranges are made smaller, down to
+    READER_LIDAR_MIN_SHOTS, so that every thread gets one.  */
+
+#define         READER_LIDAR_SHOTS      (1024 * 1024)
+#define         READER_LIDAR_MIN_SHOTS  (64 * 1024)
+
+
+/*  LAS files with at least twice this many points are split into ranges of this many points.  */
+
+#define         READER_LAS_POINTS       (4 * 1024 * 1024)
+
+
+/*  Point files with at least twice this many chunks are split into ranges of this many chunks.  */
+
+#define         READER_POINT_CHUNKS     16
+
+
+/*  PFM files with at least twice this many bin rows (in the area being read) are split into bands of this many
+    rows.  If there are fewer files than decoder threads (see min_ranges in READER_OPTIONS) the bands are made smaller,
+    down to READER_PFM_MIN_ROWS, so that every thread gets one.  */
+
+#define         READER_PFM_ROWS         128
+#define         READER_PFM_MIN_ROWS     16
+
+
+/*  How much of the start of each file reader_prefetch asks the kernel to read ahead of time.  */
+
+#define         READER_PREFETCH_BYTES   (64 * 1024 * 1024)
+
+
+/*  Part of an input file.  The units of start and end depend on the file type (bytes for YXZ and XYZ files, zero
+    based ping numbers for GSF files, zero based shot numbers for HOF and TOF files, zero based point numbers for LAS
+    files, chunk numbers for point files, bin rows for PFM files).  An end less than zero means the end of the file.  */
+
+typedef struct
+{
+  int64_t       start;
+  int64_t       end;
+} READER_RANGE;
+
+
+/*  Options that apply to every file being read.  */
+
+typedef struct
+{
+  int32_t       date_line;                  /*  1 if area crosses date line  */
+  uint8_t       nominal;                    /*  Use nominal depth for GSF files  */
+  uint8_t       fast_geolocation;           /*  Use the tangent plane beam positioning for GSF files (see geolocate.c)  */
+  uint8_t       cull;                       /*  Skip GSF pings whose swath is entirely outside of cull_mbr  */
+  NV_F64_MBR    cull_mbr;                   /*  Area of interest in degrees (elon > 180 if date_line is set)  */
+  uint8_t       las_skip[256];              /*  Non-zero for LAS classifications that shouldn't be used  */
+  int32_t       min_ranges;                 /*  Ranges reader_plan should try to split each file into (set by ingest)  */
+} READER_OPTIONS;
+
+
+/*  Per input file reader state.  This is opaque so that programs using the reader don't need the GSF, PFM, LLZ, and
+    CHARTS headers.  Each context is independent of all others so different files may be read from different threads
+    at the same time.  */
+
+typedef struct READER_CONTEXT READER_CONTEXT;
+
+
+READER_BLOCK *reader_block_alloc (int32_t size);
+void reader_block_free (READER_BLOCK *block);
+int32_t reader_file_type (char *file);
+uint8_t reader_is_pipe (char *file);
+void reader_prefetch (char *file);
+int32_t reader_plan (char *file, READER_OPTIONS *options, READER_RANGE **ranges);
+READER_CONTEXT *reader_open (char *file, READER_OPTIONS *options);
+READER_CONTEXT *reader_open_range (char *file, READER_RANGE *range, READER_OPTIONS *options);
+int32_t reader_read (READER_CONTEXT *ctx, READER_BLOCK *block);
+int32_t reader_percent (READER_CONTEXT *ctx);
+int64_t reader_culled (READER_CONTEXT *ctx);
+void reader_close (READER_CONTEXT *ctx);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
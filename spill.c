@@ -0,0 +1,682 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        spill                                               *
+*                                                                           *
+*   Purpose:            External sort of the input points into Morton       *
+*                       (Z-order) order of their grid cells so that MISP is *
+*                       loaded a neighborhood at a time instead of in file  *
+*                       order (which scatters the loads over the whole      *
+*                       grid).  Points are gathered in memory until         *
+*                       memory_mb is used, then the batch is sorted on the  *
+*                       cell keys and written to a run file in directory.   *
+*                       spill_finish merges the runs (a heap of the head    *
+*                       point of each run) and hands the points to the      *
+*                       emit function in order.  No more than fan_in runs   *
+*                       (at most SPILL_FAN_IN, fewer if memory_mb won't     *
+*                       give each one SPILL_READ_POINTS of buffer) are open *
+*                       at once.  If there are more, groups of fan_in runs  *
+*                       are merged into bigger runs until the rest can be   *
+*                       merged in one pass.  If everything fits in memory   *
+*                       nothing is written.                                 *
+*                                                                           *
+*                       Positions are in the grid domain used by main (0.0  *
+*                       to gridcols and 0.0 to gridrows with the nodes at   *
+*                       whole numbers).  Points more than margin grid cells *
+*                       outside of the chart are dropped and counted.       *
+*                                                                           *
+*                       A spill made with spill_create_geographic keeps the *
+*                       positions in degrees (longitudes in -180 to 180),   *
+*                       never drops anything, and sorts on a Morton key of  *
+*                       the position scaled to 32 bits over the whole       *
+*                       globe.  The point file writer uses it.              *
+*                                                                           *
+\***************************************************************************/
+
+#include <unistd.h>
+
+#include "morton.h"
+#include "spill.h"
+
+
+/*  Points read from each run at a time during the merge (at least).  */
+
+#define         SPILL_READ_POINTS       4096
+
+
+/*  Most run files merged (and open) at once.  */
+
+#define         SPILL_FAN_IN            256
+
+
+typedef struct
+{
+  double               x;
+  double               y;
+  double               z;
+} SPILL_POINT;
+
+
+/*  One run file during the merge.  */
+
+typedef struct
+{
+  FILE                 *fp;
+  SPILL_POINT          *buffer;
+  int64_t              size;                /*  Points the buffer will hold  */
+  int64_t              count;               /*  Points in buffer  */
+  int64_t              next;                /*  Next point in buffer  */
+  int64_t              left;                /*  Points still in the file  */
+  uint64_t             key;                 /*  Cell key of buffer[next]  */
+} SPILL_RUN;
+
+
+struct SPILL
+{
+  char                 *directory;
+  NV_F64_MBR           mbr;
+  double               x_griddeg;
+  double               y_griddeg;
+  int32_t              margin;
+  int32_t              cols;                /*  Grid cells, including the margins  */
+  int32_t              rows;
+  int64_t              memory;              /*  Bytes  */
+  SPILL_POINT          *points;
+  MORTON_KEY           *keys;
+  int64_t              count;
+  int64_t              size;
+  int64_t              max_points;          /*  Points that fit in memory  */
+  int64_t              *run_counts;
+  int32_t              num_runs;            /*  Run files written (including merged ones)  */
+  int32_t              fan_in;
+  int32_t              id;                  /*  Keeps the run file names of different spills apart  */
+  uint8_t              geographic;          /*  Made by spill_create_geographic  */
+  int64_t              out_of_area;
+};
+
+
+static int32_t         spill_count = 0;
+
+
+
+/*  Run file name.  */
+
+static void run_name (SPILL *spill, int32_t run, char *path, int32_t size)
+{
+  snprintf (path, size, "%s/chrtr2_spill_%d_%d_%04d.tmp", spill->directory, (int32_t) getpid (), spill->id, run);
+}
+
+
+
+/*  Morton key of the grid cell a point (in grid units) is in.  The cells are centered on the nodes and shifted by the
+    margin so they start at 0.  For a geographic spill it's the key of the position (in degrees) scaled to 32 bits
+    across the globe (about a centimeter).  */
+
+static uint64_t cell_key (SPILL *spill, double x, double y)
+{
+  if (spill->geographic)
+    return (morton_key ((uint32_t) MAX (0.0, MIN ((x + 180.0) / 360.0 * 4294967295.0, 4294967295.0)),
+                        (uint32_t) MAX (0.0, MIN ((y + 90.0) / 180.0 * 4294967295.0, 4294967295.0))));
+
+  return (morton_key ((uint32_t) (x + spill->margin + 0.5), (uint32_t) (y + spill->margin + 0.5)));
+}
+
+
+
+/*  Allocate a spill with everything but the area set up.  */
+
+static SPILL *new_spill (char *directory, int32_t memory_mb)
+{
+  SPILL                *spill;
+
+
+  spill = (SPILL *) calloc (1, sizeof (SPILL));
+  if (spill == NULL)
+    {
+      perror ("Allocating spill sort");
+      exit (-1);
+    }
+
+  if (memory_mb <= 0) memory_mb = SPILL_MEMORY_MB;
+
+  spill->directory = strdup (directory);
+  spill->id = spill_count++;
+  spill->memory = (int64_t) memory_mb * 1048576;
+
+
+  /*  Each point needs its SPILL_POINT and two MORTON_KEYs (morton_sort's scratch copy).  */
+
+  spill->max_points = MAX (spill->memory / (int64_t) (sizeof (SPILL_POINT) + 2 * sizeof (MORTON_KEY)),
+                           SPILL_READ_POINTS);
+
+  spill->fan_in = MAX (MIN (spill->memory / (int64_t) (SPILL_READ_POINTS * sizeof (SPILL_POINT)), SPILL_FAN_IN), 2);
+
+  return (spill);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        spill_create                                        *
+*                                                                           *
+*   Purpose:            Set up the spill sort.                              *
+*                                                                           *
+*   Inputs:             directory   -   where to put the run files          *
+*                       memory_mb   -   memory to use for the points that   *
+*                                       haven't been written yet            *
+*                       mbr         -   chart bounds in degrees             *
+*                       x_griddeg   -   grid cell width in degrees          *
+*                       y_griddeg   -   grid cell height in degrees         *
+*                       gridcols    -   grid width                          *
+*                       gridrows    -   grid height                         *
+*                       margin      -   extra grid cells on each side       *
+*                                                                           *
+*   Outputs:            SPILL *     -   the spill sort                      *
+*                                                                           *
+\***************************************************************************/
+
+SPILL *spill_create (char *directory, int32_t memory_mb, NV_F64_MBR *mbr, double x_griddeg, double y_griddeg,
+                     int32_t gridcols, int32_t gridrows, int32_t margin)
+{
+  SPILL                *spill;
+
+
+  spill = new_spill (directory, memory_mb);
+
+  spill->mbr = *mbr;
+  spill->x_griddeg = x_griddeg;
+  spill->y_griddeg = y_griddeg;
+  spill->margin = margin;
+  spill->cols = gridcols + 1 + 2 * margin;
+  spill->rows = gridrows + 1 + 2 * margin;
+
+  return (spill);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        spill_create_geographic                             *
+*                                                                           *
+*   Purpose:            Set up a spill sort of positions in degrees (see    *
+*                       the top of this file).                              *
+*                                                                           *
+*   Inputs:             directory   -   where to put the run files          *
+*                       memory_mb   -   memory to use for the points that   *
+*                                       haven't been written yet            *
+*                                                                           *
+*   Outputs:            SPILL *     -   the spill sort                      *
+*                                                                           *
+\***************************************************************************/
+
+SPILL *spill_create_geographic (char *directory, int32_t memory_mb)
+{
+  SPILL                *spill;
+
+
+  spill = new_spill (directory, memory_mb);
+  spill->geographic = NVTrue;
+
+  return (spill);
+}
+
+
+
+/*  Remember the number of points in the run file that was just written.  */
+
+static void add_run (SPILL *spill, int64_t count)
+{
+  spill->run_counts = (int64_t *) realloc (spill->run_counts, (spill->num_runs + 1) * sizeof (int64_t));
+  if (spill->run_counts == NULL)
+    {
+      perror ("Allocating spill runs");
+      exit (-1);
+    }
+
+  spill->run_counts[spill->num_runs++] = count;
+}
+
+
+
+/*  Sort the points in memory and write them to the next run file.  */
+
+static void write_run (SPILL *spill)
+{
+  FILE                 *fp;
+  SPILL_POINT          stage[SPILL_READ_POINTS];
+  char                 path[1024];
+  int64_t              i, n;
+
+
+  morton_sort (spill->keys, spill->count);
+
+  run_name (spill, spill->num_runs, path, sizeof (path));
+
+  if ((fp = fopen (path, "wb")) == NULL)
+    {
+      perror (path);
+      exit (-1);
+    }
+
+  for (i = 0, n = 0 ; i < spill->count ; i++)
+    {
+      stage[n++] = spill->points[spill->keys[i].index];
+
+      if (n == SPILL_READ_POINTS || i == spill->count - 1)
+        {
+          fwrite (stage, sizeof (SPILL_POINT), n, fp);
+          n = 0;
+        }
+    }
+
+  if (ferror (fp) || fclose (fp))
+    {
+      perror (path);
+      exit (-1);
+    }
+
+  add_run (spill, spill->count);
+  spill->count = 0;
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        spill_add                                           *
+*                                                                           *
+*   Purpose:            Add a block of points (in degrees).  A run file is  *
+*                       written whenever memory fills up.                   *
+*                                                                           *
+\***************************************************************************/
+
+void spill_add (SPILL *spill, READER_BLOCK *block)
+{
+  SPILL_POINT          *point;
+  double               x, y, col, row;
+  int32_t              i;
+
+
+  for (i = 0 ; i < block->count ; i++)
+    {
+      if (spill->geographic)
+        {
+          x = block->x[i] > 180.0 ? block->x[i] - 360.0 : block->x[i];
+          y = block->y[i];
+        }
+      else
+        {
+          /*  Same conversion as load_block in main.c.  */
+
+          x = (block->x[i] - spill->mbr.wlon) / spill->x_griddeg;
+          y = (block->y[i] - spill->mbr.slat) / spill->y_griddeg;
+
+          col = x + spill->margin + 0.5;
+          row = y + spill->margin + 0.5;
+
+          if (col < 0.0 || row < 0.0 || col >= spill->cols || row >= spill->rows)
+            {
+              spill->out_of_area++;
+              continue;
+            }
+        }
+
+
+      /*  Grow the buffers (up to max_points) or write a run if they're full.  */
+
+      if (spill->count == spill->size)
+        {
+          if (spill->size == spill->max_points)
+            {
+              write_run (spill);
+            }
+          else
+            {
+              spill->size = MIN (MAX (spill->size * 2, SPILL_READ_POINTS * 16), spill->max_points);
+
+              spill->points = (SPILL_POINT *) realloc (spill->points, spill->size * sizeof (SPILL_POINT));
+              spill->keys = (MORTON_KEY *) realloc (spill->keys, spill->size * sizeof (MORTON_KEY));
+
+              if (spill->points == NULL || spill->keys == NULL)
+                {
+                  perror ("Allocating spill points");
+                  exit (-1);
+                }
+            }
+        }
+
+      point = &spill->points[spill->count];
+      point->x = x;
+      point->y = y;
+      point->z = block->z[i];
+
+      spill->keys[spill->count].key = cell_key (spill, x, y);
+      spill->keys[spill->count].index = spill->count;
+      spill->count++;
+    }
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        spill_out_of_area                                   *
+*                                                                           *
+*   Purpose:            Number of points that fell outside of the chart     *
+*                       plus the margin.                                    *
+*                                                                           *
+\***************************************************************************/
+
+int64_t spill_out_of_area (SPILL *spill)
+{
+  return (spill->out_of_area);
+}
+
+
+
+/*  Get a run's next point ready (reading more of the file if needed).  Returns NVFalse when the run is empty.  */
+
+static uint8_t next_point (SPILL *spill, SPILL_RUN *run)
+{
+  if (run->next == run->count)
+    {
+      if (!run->left) return (NVFalse);
+
+      run->count = MIN (run->left, run->size);
+      run->next = 0;
+
+      if (fread (run->buffer, sizeof (SPILL_POINT), run->count, run->fp) != (size_t) run->count)
+        {
+          perror ("Reading spill run");
+          exit (-1);
+        }
+
+      run->left -= run->count;
+    }
+
+  run->key = cell_key (spill, run->buffer[run->next].x, run->buffer[run->next].y);
+
+  return (NVTrue);
+}
+
+
+
+/*  Move heap[i] down to where it belongs (smallest key at the top).  */
+
+static void sift_down (SPILL_RUN **heap, int32_t count, int32_t i)
+{
+  SPILL_RUN            *tmp;
+  int32_t              child;
+
+
+  while ((child = 2 * i + 1) < count)
+    {
+      if (child + 1 < count && heap[child + 1]->key < heap[child]->key) child++;
+      if (heap[i]->key <= heap[child]->key) break;
+
+      tmp = heap[i];
+      heap[i] = heap[child];
+      heap[child] = tmp;
+      i = child;
+    }
+}
+
+
+
+/*  Where merge_runs writes when it's building a bigger run instead of emitting.  */
+
+typedef struct
+{
+  FILE                 *fp;
+  SPILL_POINT          stage[SPILL_READ_POINTS];
+  int32_t              count;
+} SPILL_OUTPUT;
+
+
+static void flush_output (SPILL_OUTPUT *out)
+{
+  if (out->count) fwrite (out->stage, sizeof (SPILL_POINT), out->count, out->fp);
+  out->count = 0;
+}
+
+
+/*  SPILL_EMIT for merge_runs when it's writing a run file.  */
+
+static void write_point (NV_F64_COORD3 xyz, void *user_data)
+{
+  SPILL_OUTPUT         *out = (SPILL_OUTPUT *) user_data;
+
+
+  out->stage[out->count].x = xyz.x;
+  out->stage[out->count].y = xyz.y;
+  out->stage[out->count].z = xyz.z;
+
+  if (++out->count == SPILL_READ_POINTS) flush_output (out);
+}
+
+
+
+/*  Merge count runs starting at run first, handing the points to emit in order, then remove the run files.  The
+    memory is split between the runs' read buffers.  */
+
+static void merge_runs (SPILL *spill, int32_t first, int32_t count, SPILL_EMIT emit, void *user_data)
+{
+  SPILL_RUN            *runs, **heap, *run;
+  NV_F64_COORD3        xyz;
+  char                 path[1024];
+  int64_t              total, done;
+  int32_t              j, num_heap, percent, old_percent = -1;
+
+
+  runs = (SPILL_RUN *) calloc (count, sizeof (SPILL_RUN));
+  heap = (SPILL_RUN **) malloc (count * sizeof (SPILL_RUN *));
+
+  if (runs == NULL || heap == NULL)
+    {
+      perror ("Allocating spill runs");
+      exit (-1);
+    }
+
+  num_heap = 0;
+  total = 0;
+
+  for (j = 0 ; j < count ; j++)
+    {
+      run = &runs[j];
+
+      run_name (spill, first + j, path, sizeof (path));
+
+      if ((run->fp = fopen (path, "rb")) == NULL)
+        {
+          perror (path);
+          exit (-1);
+        }
+
+      run->size = MAX (spill->memory / (int64_t) sizeof (SPILL_POINT) / count, SPILL_READ_POINTS);
+      run->size = MIN (run->size, spill->run_counts[first + j]);
+      run->left = spill->run_counts[first + j];
+      total += spill->run_counts[first + j];
+
+      run->buffer = (SPILL_POINT *) malloc (MAX (run->size, 1) * sizeof (SPILL_POINT));
+      if (run->buffer == NULL)
+        {
+          perror ("Allocating spill run buffer");
+          exit (-1);
+        }
+
+      if (next_point (spill, run)) heap[num_heap++] = run;
+    }
+
+  for (j = num_heap / 2 - 1 ; j >= 0 ; j--) sift_down (heap, num_heap, j);
+
+  for (done = 0 ; num_heap ; done++)
+    {
+      run = heap[0];
+
+      xyz.x = run->buffer[run->next].x;
+      xyz.y = run->buffer[run->next].y;
+      xyz.z = run->buffer[run->next].z;
+
+      (*emit) (xyz, user_data);
+
+      run->next++;
+      if (!next_point (spill, run)) heap[0] = heap[--num_heap];
+
+      sift_down (heap, num_heap, 0);
+
+      percent = (int32_t) (done * 100 / total);
+      if (percent != old_percent)
+        {
+          fprintf (stderr, "%03d%% merged             \r", percent);
+          fflush (stderr);
+          old_percent = percent;
+        }
+    }
+
+  fprintf (stderr, "100%% merged             \n");
+  fflush (stderr);
+
+  for (j = 0 ; j < count ; j++)
+    {
+      fclose (runs[j].fp);
+      free (runs[j].buffer);
+
+      run_name (spill, first + j, path, sizeof (path));
+      remove (path);
+    }
+
+  free (runs);
+  free (heap);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        spill_finish                                        *
+*                                                                           *
+*   Purpose:            Hand all of the points to emit in Morton order of   *
+*                       their grid cells, remove the run files, and free    *
+*                       the spill sort.                                     *
+*                                                                           *
+\***************************************************************************/
+
+void spill_finish (SPILL *spill, SPILL_EMIT emit, void *user_data)
+{
+  SPILL_OUTPUT         *out;
+  NV_F64_COORD3        xyz;
+  char                 path[1024];
+  int64_t              i, points;
+  int32_t              first, group, j;
+
+
+  /*  If nothing was written we just sort what's in memory.  */
+
+  if (!spill->num_runs)
+    {
+      morton_sort (spill->keys, spill->count);
+
+      for (i = 0 ; i < spill->count ; i++)
+        {
+          xyz.x = spill->points[spill->keys[i].index].x;
+          xyz.y = spill->points[spill->keys[i].index].y;
+          xyz.z = spill->points[spill->keys[i].index].z;
+
+          (*emit) (xyz, user_data);
+        }
+    }
+  else
+    {
+      if (spill->count) write_run (spill);
+
+      free (spill->points);
+      free (spill->keys);
+      spill->points = NULL;
+      spill->keys = NULL;
+
+
+      /*  Merge the oldest fan_in runs into a new run until what's left can be merged in one pass.  Each pass over the
+          points cuts the number of runs by a factor of fan_in.  */
+
+      first = 0;
+
+      if (spill->num_runs > spill->fan_in)
+        {
+          out = (SPILL_OUTPUT *) malloc (sizeof (SPILL_OUTPUT));
+          if (out == NULL)
+            {
+              perror ("Allocating spill output");
+              exit (-1);
+            }
+
+          while (spill->num_runs - first > spill->fan_in)
+            {
+              group = MIN (spill->fan_in, spill->num_runs - first - spill->fan_in + 1);
+
+              for (j = 0, points = 0 ; j < group ; j++) points += spill->run_counts[first + j];
+
+              run_name (spill, spill->num_runs, path, sizeof (path));
+
+              if ((out->fp = fopen (path, "wb")) == NULL)
+                {
+                  perror (path);
+                  exit (-1);
+                }
+
+              out->count = 0;
+
+              fprintf (stderr, "\n\nMerging sorted runs %d to %d of %d into one\n\n", first + 1, first + group,
+                       spill->num_runs);
+              fflush (stderr);
+
+              merge_runs (spill, first, group, write_point, out);
+              flush_output (out);
+
+              if (ferror (out->fp) || fclose (out->fp))
+                {
+                  perror (path);
+                  exit (-1);
+                }
+
+              add_run (spill, points);
+              first += group;
+            }
+
+          free (out);
+        }
+
+      fprintf (stderr, "\n\nMerging %d sorted runs\n\n", spill->num_runs - first);
+      fflush (stderr);
+
+      merge_runs (spill, first, spill->num_runs - first, emit, user_data);
+    }
+
+  free (spill->points);
+  free (spill->keys);
+  free (spill->run_counts);
+  free (spill->directory);
+  free (spill);
+}
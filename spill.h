@@ -0,0 +1,63 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+#ifndef __CHRTR2_SPILL_H__
+#define __CHRTR2_SPILL_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+#include "reader.h"
+
+
+/*  Default memory for the in-memory runs if [sort_directory] is set but [sort_memory_mb] isn't.  */
+
+#define         SPILL_MEMORY_MB         1024
+
+
+typedef struct SPILL SPILL;
+
+
+/*  Called by spill_finish for each point, in Morton order of the grid cells.  xyz is in grid units (or degrees for a
+    spill made with spill_create_geographic, see spill.c).  */
+
+typedef void (*SPILL_EMIT) (NV_F64_COORD3 xyz, void *user_data);
+
+
+SPILL *spill_create (char *directory, int32_t memory_mb, NV_F64_MBR *mbr, double x_griddeg, double y_griddeg,
+                     int32_t gridcols, int32_t gridrows, int32_t margin);
+SPILL *spill_create_geographic (char *directory, int32_t memory_mb);
+void spill_add (SPILL *spill, READER_BLOCK *block);
+int64_t spill_out_of_area (SPILL *spill);
+void spill_finish (SPILL *spill, SPILL_EMIT emit, void *user_data);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,436 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        summary                                             *
+*                                                                           *
+*   Purpose:            Keep a small summary file next to each input file   *
+*                       (or in a separate index directory) that has the     *
+*                       bounds, point count, Z range, and a coarse          *
+*                       occupancy bitmap of the points in the file.  On     *
+*                       later runs we use it to skip files that can't       *
+*                       touch the chart without reading them.  The input    *
+*                       file's size and modification time are saved in the  *
+*                       summary and if either one changes the summary is    *
+*                       ignored (and rebuilt).                              *
+*                                                                           *
+*                       The summary file is plain text in the same          *
+*                       [KEYWORD] = value form as the parameter file,       *
+*                       followed by the occupied cell numbers (row *        *
+*                       SUMMARY_COLS + col), sixteen per line.              *
+*                                                                           *
+\***************************************************************************/
+
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "summary.h"
+
+
+#define SUMMARY_VERSION         1
+#define SUMMARY_BYTES           ((int64_t) SUMMARY_ROWS * SUMMARY_COLS / 8)
+
+
+
+/*  Build the summary file name.  In an index directory the whole input path (with the separators changed to
+    underscores) is used so that files with the same name in different directories don't collide.  */
+
+static void summary_path (char *file, char *directory, char *path, int32_t size)
+{
+  char                 name[1024];
+  int32_t              i;
+
+
+  if (directory == NULL || !directory[0])
+    {
+      snprintf (path, size, "%s%s", file, SUMMARY_EXTENSION);
+      return;
+    }
+
+  strncpy (name, file, sizeof (name) - 1);
+  name[sizeof (name) - 1] = 0;
+
+  for (i = 0 ; name[i] ; i++)
+    {
+      if (name[i] == '/' || name[i] == '\\' || name[i] == ':') name[i] = '_';
+    }
+
+  snprintf (path, size, "%s/%s%s", directory, name, SUMMARY_EXTENSION);
+}
+
+
+
+/*  Get the size and modification time of the input file.  */
+
+static uint8_t file_stamp (char *file, int64_t *size, int64_t *mtime)
+{
+  struct stat          st;
+
+
+  if (stat (file, &st)) return (NVFalse);
+
+  *size = st.st_size;
+  *mtime = st.st_mtime;
+
+  return (NVTrue);
+}
+
+
+
+static void alloc_occupancy (FILE_SUMMARY *summary)
+{
+  summary->occupancy = (uint8_t *) calloc (SUMMARY_BYTES, 1);
+  if (summary->occupancy == NULL)
+    {
+      perror ("Allocating file summary");
+      exit (-1);
+    }
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        summary_init, summary_free                          *
+*                                                                           *
+*   Purpose:            Set up an empty summary and free it.                *
+*                                                                           *
+\***************************************************************************/
+
+void summary_init (FILE_SUMMARY *summary)
+{
+  memset (summary, 0, sizeof (FILE_SUMMARY));
+
+  summary->mbr.slat = summary->mbr.wlon = 999.0;
+  summary->mbr.nlat = summary->mbr.elon = -999.0;
+  summary->min_z = 999999999.0;
+  summary->max_z = -999999999.0;
+
+  alloc_occupancy (summary);
+}
+
+
+void summary_free (FILE_SUMMARY *summary)
+{
+  if (summary->occupancy) free (summary->occupancy);
+  summary->occupancy = NULL;
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        summary_add                                         *
+*                                                                           *
+*   Purpose:            Add a block of points to a summary.  The block may  *
+*                       have been shifted to 0 to 360 for the date line so  *
+*                       we put it back to -180 to 180.                      *
+*                                                                           *
+\***************************************************************************/
+
+void summary_add (FILE_SUMMARY *summary, READER_BLOCK *block)
+{
+  double               x, y, z;
+  int32_t              i, row, col;
+  int64_t              cell;
+
+
+  for (i = 0 ; i < block->count ; i++)
+    {
+      x = block->x[i];
+      y = block->y[i];
+      z = block->z[i];
+
+      if (x > 180.0) x -= 360.0;
+
+      summary->mbr.slat = MIN (summary->mbr.slat, y);
+      summary->mbr.nlat = MAX (summary->mbr.nlat, y);
+      summary->mbr.wlon = MIN (summary->mbr.wlon, x);
+      summary->mbr.elon = MAX (summary->mbr.elon, x);
+      summary->min_z = MIN (summary->min_z, z);
+      summary->max_z = MAX (summary->max_z, z);
+
+      row = (int32_t) ((y + 90.0) * SUMMARY_CELLS_PER_DEGREE);
+      col = (int32_t) ((x + 180.0) * SUMMARY_CELLS_PER_DEGREE);
+      row = MAX (0, MIN (row, SUMMARY_ROWS - 1));
+      col = MAX (0, MIN (col, SUMMARY_COLS - 1));
+
+      cell = (int64_t) row * SUMMARY_COLS + col;
+      summary->occupancy[cell >> 3] |= (1 << (cell & 7));
+    }
+
+  summary->num_points += block->count;
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        summary_merge                                       *
+*                                                                           *
+*   Purpose:            Add the summary of part of a file to the summary    *
+*                       of the whole file.                                  *
+*                                                                           *
+\***************************************************************************/
+
+void summary_merge (FILE_SUMMARY *summary, FILE_SUMMARY *part)
+{
+  int64_t              i;
+
+
+  if (!part->num_points) return;
+
+  summary->mbr.slat = MIN (summary->mbr.slat, part->mbr.slat);
+  summary->mbr.nlat = MAX (summary->mbr.nlat, part->mbr.nlat);
+  summary->mbr.wlon = MIN (summary->mbr.wlon, part->mbr.wlon);
+  summary->mbr.elon = MAX (summary->mbr.elon, part->mbr.elon);
+  summary->min_z = MIN (summary->min_z, part->min_z);
+  summary->max_z = MAX (summary->max_z, part->max_z);
+  summary->num_points += part->num_points;
+
+  for (i = 0 ; i < SUMMARY_BYTES ; i++) summary->occupancy[i] |= part->occupancy[i];
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        summary_overlaps                                    *
+*                                                                           *
+*   Purpose:            Check for occupied summary cells in an area.        *
+*                                                                           *
+*   Inputs:             summary     -   file summary                        *
+*                       mbr         -   area (elon may be past 180 if the   *
+*                                       area crosses the date line)         *
+*                                                                           *
+*   Outputs:            uint8_t     -   NVTrue if any cell in the area has  *
+*                                       points                              *
+*                                                                           *
+\***************************************************************************/
+
+uint8_t summary_overlaps (FILE_SUMMARY *summary, NV_F64_MBR *mbr)
+{
+  int32_t              row, first_row, last_row, c, col, first_col, last_col;
+  int64_t              cell;
+
+
+  if (!summary->num_points) return (NVFalse);
+
+  first_row = MAX (0, (int32_t) floor ((mbr->slat + 90.0) * SUMMARY_CELLS_PER_DEGREE));
+  last_row = MIN (SUMMARY_ROWS - 1, (int32_t) floor ((mbr->nlat + 90.0) * SUMMARY_CELLS_PER_DEGREE));
+
+  first_col = (int32_t) floor ((mbr->wlon + 180.0) * SUMMARY_CELLS_PER_DEGREE);
+  last_col = (int32_t) floor ((mbr->elon + 180.0) * SUMMARY_CELLS_PER_DEGREE);
+  if (last_col - first_col >= SUMMARY_COLS) last_col = first_col + SUMMARY_COLS - 1;
+
+  for (row = first_row ; row <= last_row ; row++)
+    {
+      for (c = first_col ; c <= last_col ; c++)
+        {
+          col = ((c % SUMMARY_COLS) + SUMMARY_COLS) % SUMMARY_COLS;
+          cell = (int64_t) row * SUMMARY_COLS + col;
+
+          if (summary->occupancy[cell >> 3] & (1 << (cell & 7))) return (NVTrue);
+        }
+    }
+
+  return (NVFalse);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        summary_read                                        *
+*                                                                           *
+*   Purpose:            Read the summary for an input file.                 *
+*                                                                           *
+*   Inputs:             file        -   input file name                     *
+*                       directory   -   index directory or NULL to look     *
+*                                       next to the input file              *
+*                       summary     -   summary (free with summary_free)    *
+*                                                                           *
+*   Outputs:            uint8_t     -   NVTrue if there is a summary and    *
+*                                       the input file hasn't changed since *
+*                                       it was written                      *
+*                                                                           *
+\***************************************************************************/
+
+uint8_t summary_read (char *file, char *directory, FILE_SUMMARY *summary)
+{
+  FILE                 *fp;
+  char                 path[2048], varin[8192], info[8192], *ptr, *end;
+  int32_t              version = 0, cells_per_degree = 0;
+  int64_t              size, mtime, cell, num_cells = -1, count = 0;
+
+
+  memset (summary, 0, sizeof (FILE_SUMMARY));
+
+  if (!file_stamp (file, &size, &mtime)) return (NVFalse);
+
+  summary_path (file, directory, path, sizeof (path));
+
+  if ((fp = fopen (path, "r")) == NULL) return (NVFalse);
+
+
+  /*  Header.  */
+
+  while (num_cells < 0 && ngets (varin, sizeof (varin), fp) != NULL)
+    {
+      if (strchr (varin, '=') == NULL) continue;
+      strcpy (info, (strchr (varin, '=') + 1));
+
+      if (strstr (varin, "[CHRTR2 FILE SUMMARY VERSION]")) sscanf (info, "%d", &version);
+      if (strstr (varin, "[FILE SIZE]")) sscanf (info, "%" SCNd64, &summary->file_size);
+      if (strstr (varin, "[MODIFICATION TIME]")) sscanf (info, "%" SCNd64, &summary->mtime);
+      if (strstr (varin, "[POINTS]")) sscanf (info, "%" SCNd64, &summary->num_points);
+      if (strstr (varin, "[MIN LATITUDE]")) sscanf (info, "%lf", &summary->mbr.slat);
+      if (strstr (varin, "[MAX LATITUDE]")) sscanf (info, "%lf", &summary->mbr.nlat);
+      if (strstr (varin, "[MIN LONGITUDE]")) sscanf (info, "%lf", &summary->mbr.wlon);
+      if (strstr (varin, "[MAX LONGITUDE]")) sscanf (info, "%lf", &summary->mbr.elon);
+      if (strstr (varin, "[MIN Z]")) sscanf (info, "%lf", &summary->min_z);
+      if (strstr (varin, "[MAX Z]")) sscanf (info, "%lf", &summary->max_z);
+      if (strstr (varin, "[CELLS PER DEGREE]")) sscanf (info, "%d", &cells_per_degree);
+      if (strstr (varin, "[OCCUPIED CELLS]")) sscanf (info, "%" SCNd64, &num_cells);
+    }
+
+  if (version != SUMMARY_VERSION || cells_per_degree != SUMMARY_CELLS_PER_DEGREE || num_cells < 0 ||
+      summary->file_size != size || summary->mtime != mtime)
+    {
+      fclose (fp);
+      return (NVFalse);
+    }
+
+
+  /*  Occupied cells.  */
+
+  alloc_occupancy (summary);
+
+  while (count < num_cells && ngets (varin, sizeof (varin), fp) != NULL)
+    {
+      ptr = varin;
+
+      for (;;)
+        {
+          cell = strtoll (ptr, &end, 10);
+          if (end == ptr) break;
+          ptr = end;
+
+          if (cell >= 0 && cell < (int64_t) SUMMARY_ROWS * SUMMARY_COLS) summary->occupancy[cell >> 3] |= (1 << (cell & 7));
+          count++;
+        }
+    }
+
+  fclose (fp);
+
+  if (count != num_cells)
+    {
+      summary_free (summary);
+      return (NVFalse);
+    }
+
+  return (NVTrue);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        summary_write                                       *
+*                                                                           *
+*   Purpose:            Write the summary for an input file.  The summary   *
+*                       is written to a temporary file and renamed so that  *
+*                       another run reading it never sees half of one.      *
+*                       Failing to write it (e.g. read only data) isn't an  *
+*                       error, we just won't have it next time.             *
+*                                                                           *
+*   Inputs:             file        -   input file name                     *
+*                       directory   -   index directory or NULL to put it   *
+*                                       next to the input file              *
+*                       summary     -   summary                             *
+*                                                                           *
+*   Outputs:            uint8_t     -   NVTrue if it was written            *
+*                                                                           *
+\***************************************************************************/
+
+uint8_t summary_write (char *file, char *directory, FILE_SUMMARY *summary)
+{
+  FILE                 *fp;
+  char                 path[2048], tmp_path[2100];
+  int64_t              cell, num_cells = 0, count = 0;
+
+
+  if (!file_stamp (file, &summary->file_size, &summary->mtime)) return (NVFalse);
+
+  summary_path (file, directory, path, sizeof (path));
+  snprintf (tmp_path, sizeof (tmp_path), "%s.%d", path, (int32_t) getpid ());
+
+  if ((fp = fopen (tmp_path, "w")) == NULL) return (NVFalse);
+
+  for (cell = 0 ; cell < (int64_t) SUMMARY_ROWS * SUMMARY_COLS ; cell++)
+    {
+      if (summary->occupancy[cell >> 3] & (1 << (cell & 7))) num_cells++;
+    }
+
+  fprintf (fp, "[CHRTR2 FILE SUMMARY VERSION] = %d\n", SUMMARY_VERSION);
+  fprintf (fp, "[FILE SIZE] = %" PRId64 "\n", summary->file_size);
+  fprintf (fp, "[MODIFICATION TIME] = %" PRId64 "\n", summary->mtime);
+  fprintf (fp, "[POINTS] = %" PRId64 "\n", summary->num_points);
+  fprintf (fp, "[MIN LATITUDE] = %.11f\n", summary->mbr.slat);
+  fprintf (fp, "[MAX LATITUDE] = %.11f\n", summary->mbr.nlat);
+  fprintf (fp, "[MIN LONGITUDE] = %.11f\n", summary->mbr.wlon);
+  fprintf (fp, "[MAX LONGITUDE] = %.11f\n", summary->mbr.elon);
+  fprintf (fp, "[MIN Z] = %.6f\n", summary->min_z);
+  fprintf (fp, "[MAX Z] = %.6f\n", summary->max_z);
+  fprintf (fp, "[CELLS PER DEGREE] = %d\n", SUMMARY_CELLS_PER_DEGREE);
+  fprintf (fp, "[OCCUPIED CELLS] = %" PRId64 "\n", num_cells);
+
+  for (cell = 0 ; cell < (int64_t) SUMMARY_ROWS * SUMMARY_COLS ; cell++)
+    {
+      if (summary->occupancy[cell >> 3] & (1 << (cell & 7)))
+        {
+          fprintf (fp, "%" PRId64 "%c", cell, (++count % 16) ? ' ' : '\n');
+        }
+    }
+  if (count % 16) fprintf (fp, "\n");
+
+  if (fclose (fp))
+    {
+      remove (tmp_path);
+      return (NVFalse);
+    }
+
+#ifdef NVWIN3X
+  remove (path);
+#endif
+
+  if (rename (tmp_path, path))
+    {
+      remove (tmp_path);
+      return (NVFalse);
+    }
+
+  return (NVTrue);
+}
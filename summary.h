@@ -0,0 +1,78 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+
+#ifndef __CHRTR2_SUMMARY_H__
+#define __CHRTR2_SUMMARY_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "reader.h"
+
+
+/*  Extension added to the input file name to get the summary file name.  */
+
+#define         SUMMARY_EXTENSION           ".ch2s"
+
+
+/*  The occupancy bitmap is a global grid of this many cells per degree.  Only the occupied cells get written to the
+    summary file.  */
+
+#define         SUMMARY_CELLS_PER_DEGREE    8
+#define         SUMMARY_COLS                (360 * SUMMARY_CELLS_PER_DEGREE)
+#define         SUMMARY_ROWS                (180 * SUMMARY_CELLS_PER_DEGREE)
+
+
+/*  Spatial summary of an input file.  The file size and modification time are used to tell if the summary is still
+    good.  */
+
+typedef struct
+{
+  int64_t       file_size;                  /*  Size of the input file when the summary was made  */
+  int64_t       mtime;                      /*  Modification time of the input file when the summary was made  */
+  int64_t       num_points;                 /*  Number of points in the file  */
+  NV_F64_MBR    mbr;                        /*  Bounds of the points (-180 to 180)  */
+  double        min_z;                      /*  Z range of the points  */
+  double        max_z;
+  uint8_t       *occupancy;                 /*  SUMMARY_ROWS x SUMMARY_COLS bits, set if the cell has points  */
+} FILE_SUMMARY;
+
+
+void summary_init (FILE_SUMMARY *summary);
+void summary_free (FILE_SUMMARY *summary);
+void summary_add (FILE_SUMMARY *summary, READER_BLOCK *block);
+void summary_merge (FILE_SUMMARY *summary, FILE_SUMMARY *part);
+uint8_t summary_overlaps (FILE_SUMMARY *summary, NV_F64_MBR *mbr);
+uint8_t summary_read (char *file, char *directory, FILE_SUMMARY *summary);
+uint8_t summary_write (char *file, char *directory, FILE_SUMMARY *summary);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,273 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        surface                                             *
+*                                                                           *
+*   Purpose:            In memory copy of the gridded surface (Z and cell   *
+*                       flags) used when nibbling.  The cells are stored in *
+*                       SURFACE_TILE x SURFACE_TILE tiles (each tile's Z    *
+*                       and flags are contiguous) so that sweeps down the   *
+*                       columns touch one cache line per row of a tile      *
+*                       instead of one per cell.  Rows are only put         *
+*                       together when they're asked for (surface_get_row).  *
+*                                                                           *
+*                       Nibbling keeps every cell that has a real cell      *
+*                       within distance cells in X and Y (a square window). *
+*                       That's a dilation of the real cells by the window,  *
+*                       which is done as a pass along the rows followed by  *
+*                       a pass down the columns.  Each pass sweeps forward  *
+*                       and back remembering the last real cell it saw, so  *
+*                       the cost doesn't depend on the nibble distance.     *
+*                                                                           *
+\***************************************************************************/
+
+#include "surface.h"
+
+
+/*  Set by the row pass on cells that have a real cell within distance in the same row.  */
+
+#define         SURFACE_NEAR            4
+
+
+struct SURFACE
+{
+  int32_t              cols;
+  int32_t              rows;
+  int32_t              tiles_x;
+  int32_t              tiles_y;
+  float                *z;                  /*  tiles_x * tiles_y tiles of SURFACE_TILE * SURFACE_TILE  */
+  uint8_t              *flags;
+};
+
+
+/*  Offset of the start of row (within its tile) in tile tile_x.  */
+
+static size_t tile_row (SURFACE *surface, int32_t row, int32_t tile_x)
+{
+  return (((size_t) (row / SURFACE_TILE) * surface->tiles_x + tile_x) * SURFACE_TILE * SURFACE_TILE +
+          (row % SURFACE_TILE) * SURFACE_TILE);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        surface_create                                      *
+*                                                                           *
+*   Purpose:            Allocate a cols x rows surface.                     *
+*                                                                           *
+\***************************************************************************/
+
+SURFACE *surface_create (int32_t cols, int32_t rows)
+{
+  SURFACE              *surface;
+  size_t               cells;
+
+
+  surface = (SURFACE *) calloc (1, sizeof (SURFACE));
+  if (surface == NULL)
+    {
+      perror ("Allocating surface");
+      exit (-1);
+    }
+
+  surface->cols = cols;
+  surface->rows = rows;
+  surface->tiles_x = (cols + SURFACE_TILE - 1) / SURFACE_TILE;
+  surface->tiles_y = (rows + SURFACE_TILE - 1) / SURFACE_TILE;
+
+  cells = (size_t) surface->tiles_x * surface->tiles_y * SURFACE_TILE * SURFACE_TILE;
+
+
+  /*  The cells past the edges of the grid in the last row and column of tiles are never set so they're never real.  */
+
+  surface->z = (float *) malloc (cells * sizeof (float));
+  surface->flags = (uint8_t *) calloc (cells, sizeof (uint8_t));
+
+  if (surface->z == NULL || surface->flags == NULL)
+    {
+      perror ("Allocating surface tiles");
+      exit (-1);
+    }
+
+  return (surface);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        surface_put_row                                     *
+*                                                                           *
+*   Purpose:            Store a row of Z values and flags (SURFACE_REAL or  *
+*                       0).                                                 *
+*                                                                           *
+\***************************************************************************/
+
+void surface_put_row (SURFACE *surface, int32_t row, float *z, uint8_t *flags)
+{
+  size_t               offset;
+  int32_t              tile_x, n;
+
+
+  for (tile_x = 0 ; tile_x < surface->tiles_x ; tile_x++)
+    {
+      offset = tile_row (surface, row, tile_x);
+      n = MIN (SURFACE_TILE, surface->cols - tile_x * SURFACE_TILE);
+
+      memcpy (&surface->z[offset], &z[tile_x * SURFACE_TILE], n * sizeof (float));
+      memcpy (&surface->flags[offset], &flags[tile_x * SURFACE_TILE], n);
+    }
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        surface_get_row                                     *
+*                                                                           *
+*   Purpose:            Put together a row of Z values and flags.           *
+*                                                                           *
+\***************************************************************************/
+
+void surface_get_row (SURFACE *surface, int32_t row, float *z, uint8_t *flags)
+{
+  size_t               offset;
+  int32_t              tile_x, n;
+
+
+  for (tile_x = 0 ; tile_x < surface->tiles_x ; tile_x++)
+    {
+      offset = tile_row (surface, row, tile_x);
+      n = MIN (SURFACE_TILE, surface->cols - tile_x * SURFACE_TILE);
+
+      memcpy (&z[tile_x * SURFACE_TILE], &surface->z[offset], n * sizeof (float));
+      memcpy (&flags[tile_x * SURFACE_TILE], &surface->flags[offset], n);
+    }
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        surface_nibble                                      *
+*                                                                           *
+*   Purpose:            Set SURFACE_KEEP on every cell that has a           *
+*                       SURFACE_REAL cell within distance cells in both X   *
+*                       and Y (including the real cells themselves).        *
+*                                                                           *
+\***************************************************************************/
+
+void surface_nibble (SURFACE *surface, int32_t distance)
+{
+  uint8_t              *row_flags, *flags;
+  int32_t              row, col, tile_x, i, last, last_row[SURFACE_TILE];
+
+
+  row_flags = (uint8_t *) malloc (surface->tiles_x * SURFACE_TILE);
+  if (row_flags == NULL)
+    {
+      perror ("Allocating nibble row");
+      exit (-1);
+    }
+
+
+  /*  Along the rows.  The row is copied out of the tiles so the sweeps are over contiguous memory.  Anything further
+      than distance from the last real cell is far enough away that distance + 1 works as "none seen".  */
+
+  for (row = 0 ; row < surface->rows ; row++)
+    {
+      for (tile_x = 0 ; tile_x < surface->tiles_x ; tile_x++)
+        memcpy (&row_flags[tile_x * SURFACE_TILE], &surface->flags[tile_row (surface, row, tile_x)], SURFACE_TILE);
+
+      for (col = 0, last = -distance - 1 ; col < surface->cols ; col++)
+        {
+          if (row_flags[col] & SURFACE_REAL) last = col;
+          if (col - last <= distance) row_flags[col] |= SURFACE_NEAR;
+        }
+
+      for (col = surface->cols - 1, last = surface->cols + distance ; col >= 0 ; col--)
+        {
+          if (row_flags[col] & SURFACE_REAL) last = col;
+          if (last - col <= distance) row_flags[col] |= SURFACE_NEAR;
+        }
+
+      for (tile_x = 0 ; tile_x < surface->tiles_x ; tile_x++)
+        memcpy (&surface->flags[tile_row (surface, row, tile_x)], &row_flags[tile_x * SURFACE_TILE], SURFACE_TILE);
+    }
+
+
+  /*  Down the columns, a column of tiles at a time.  Each step is one row of a tile (SURFACE_TILE contiguous bytes)
+      with the last SURFACE_NEAR row seen kept for each of its columns.  */
+
+  for (tile_x = 0 ; tile_x < surface->tiles_x ; tile_x++)
+    {
+      for (i = 0 ; i < SURFACE_TILE ; i++) last_row[i] = -distance - 1;
+
+      for (row = 0 ; row < surface->rows ; row++)
+        {
+          flags = &surface->flags[tile_row (surface, row, tile_x)];
+
+          for (i = 0 ; i < SURFACE_TILE ; i++)
+            {
+              if (flags[i] & SURFACE_NEAR) last_row[i] = row;
+              if (row - last_row[i] <= distance) flags[i] |= SURFACE_KEEP;
+            }
+        }
+
+      for (i = 0 ; i < SURFACE_TILE ; i++) last_row[i] = surface->rows + distance;
+
+      for (row = surface->rows - 1 ; row >= 0 ; row--)
+        {
+          flags = &surface->flags[tile_row (surface, row, tile_x)];
+
+          for (i = 0 ; i < SURFACE_TILE ; i++)
+            {
+              if (flags[i] & SURFACE_NEAR) last_row[i] = row;
+              if (last_row[i] - row <= distance) flags[i] |= SURFACE_KEEP;
+
+              flags[i] &= ~SURFACE_NEAR;
+            }
+        }
+    }
+
+  free (row_flags);
+}
+
+
+
+/***************************************************************************\
+*                                                                           *
+*   Module Name:        surface_free                                        *
+*                                                                           *
+*   Purpose:            Free the surface.                                   *
+*                                                                           *
+\***************************************************************************/
+
+void surface_free (SURFACE *surface)
+{
+  free (surface->z);
+  free (surface->flags);
+  free (surface);
+}
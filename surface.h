@@ -0,0 +1,61 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+
+#ifndef __CHRTR2_SURFACE_H__
+#define __CHRTR2_SURFACE_H__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+#include "nvutility.h"
+
+
+/*  The surface is stored in square tiles of SURFACE_TILE x SURFACE_TILE cells.  */
+
+#define         SURFACE_TILE            64
+
+
+/*  Cell flags.  */
+
+#define         SURFACE_REAL            1           /*  MISP says the cell has real data  */
+#define         SURFACE_KEEP            2           /*  Within the nibble distance of a SURFACE_REAL cell  */
+
+
+typedef struct SURFACE SURFACE;
+
+
+SURFACE *surface_create (int32_t cols, int32_t rows);
+void surface_put_row (SURFACE *surface, int32_t row, float *z, uint8_t *flags);
+void surface_nibble (SURFACE *surface, int32_t distance);
+void surface_get_row (SURFACE *surface, int32_t row, float *z, uint8_t *flags);
+void surface_free (SURFACE *surface);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -38,7 +38,7 @@
 
 #ifndef VERSION
 
-#define     VERSION     "PFM Software - chrtr2 V2.08 - 07/29/14"
+#define     VERSION     "PFM Software - chrtr2 V2.09 - 10/16/26"
 
 #endif
 
@@ -122,4 +122,145 @@
 
     - Fixed errors discovered by cppcheck.
 
+
+    Version 2.09
+    PFM Software
+    10/16/26
+
+    - Replaced the one point per call reader with reader_block which fills a block of points (structure of arrays)
+      per call.  File position and progress are only checked once per block.  Also fixed the PFM reader skipping the
+      first bin and running off the end of the second and later PFM files.
+    - Moved all of the reader state (file pointer, handles, GSF records, PFM row/col/rec, PFM open args, LLZ header,
+      etc.) out of function and file level statics into a READER_CONTEXT that is created with reader_open, read with
+      reader_read, and destroyed with reader_close.  Any number of files can now be read at once.
+    - Input files are now decoded by a pool of reader threads that push point blocks through a bounded lock free queue
+      to the main thread which does all of the MISP loading (see ingest.c).  The number of threads and the queue depth
+      can be set with [reader_threads] and [reader_queue_depth] in the parameter file (0 = defaults).
+    - DPG and RDP files are now memory mapped and read in place.  The byte swap (SSSE3 if available) and the all zero
+      record check are done in one pass over each block of records instead of per record.  checkinput now looks at the
+      mapped records instead of doing three freads per record.
+    - YXZ, XYZ, TXT, and RAW files are now memory mapped and parsed with a locale independent number parser (see
+      ascii.c) instead of fgets/sscanf, so there is no longer a line length limit.  Files larger than 128MB are split
+      into 64MB pieces at line boundaries and the pieces are read in parallel by the reader threads.  The "ddd-mm-
+      ss.ss[NSEW]" format shown in the usage documentation is now accepted along with the old fixed column format.
+      Lines that can't be parsed are skipped instead of reloading the previous point.
+    - GSF beam positions are now computed for a whole ping at once (see geolocate.c) instead of beam by beam in the read
+      loop.  Setting [gsf_fast_geolocation] = 1 in the parameter file replaces the two newgp calls per beam with a
+      second order tangent plane expansion on the WGS-84 ellipsoid (under a centimeter out to 5 km from nadir below 60
+      degrees).  The outermost beam of every ping is checked against newgp and the ping falls back to newgp if they
+      differ by more than 1 cm.
+    - GSF files with 20,000 or more pings are split into ranges of 10,000 pings (using the GSF index, which gsfOpen will
+      build if it isn't there) that are read in parallel by the reader threads.  Each range is read by ping number
+      through the index so only the swath bathymetry records in the range are decoded.
+    - GSF pings whose swath footprint (nadir plus the largest beam offset) is entirely outside of the area plus the
+      search radius are now skipped before any of the beams are positioned.  The number of skipped pings is printed
+      after loading.
+    - PFM files are now read a bin row at a time.  The bin records for the row come from one read_bin_row call, the
+      soundings for the row are gathered into a buffer that is reused from row to row, and the invalid/deleted/reference
+      soundings are dropped in one pass over the row.
+    - Only the PFM bins that overlap the area (plus the search radius) are read.  The bin window is computed from the
+      PFM header MBR and bin sizes.
+    - PFM files with 256 or more rows in the area are split into bands of 128 bin rows that are read in parallel (each
+      with its own PFM handle) by the reader threads.
+    - HOF and TOF shots are now read a block at a time (one fread per block on little endian systems) and the acceptance
+      checks run as one pass over each block.  Files with 2M or more shots are split into 1M shot ranges that are read
+      in parallel by the reader threads.
+    - Fixed the LLZ reader using handle 0 instead of the handle returned by open_llz (only the first LLZ file opened was
+      ever read correctly).  LLZ records are now read a block at a time and the LLZ_INVAL check runs as one pass over
+      each block.  Reading stops at number_of_records from the LLZ header.
+    - File offsets are 64 bit everywhere (ftello/fseeko, mmap sizes, and _FILE_OFFSET_BITS=64 in the build) and the
+      point and out of area counts are 64 bit.  Grid row and column counts that won't fit in 32 bits are now an error
+      instead of silently wrapping.
+    - Input files whose bounds (PFM header MBR, HOF/TOF header min/max lat/lon, or the GSF swath bathymetry summary
+      record) can't touch the area plus the search radius are skipped without being decoded.  Each skipped file is
+      listed as it is skipped and the number skipped is printed after loading.
+    - Added [file_summaries] and [index_directory] to the parameter file.  With [file_summaries] = 1 a small .ch2s
+      summary (bounds, point count, Z range, 1/8 degree occupancy cells, and the file's size and modification time) is
+      written next to each DPG, RDP, YXZ, XYZ, LLZ, HOF, and TOF input file (or in [index_directory]) the first time it
+      is read.  On later runs files whose summary shows no points in the area are skipped without being opened.  A
+      summary is ignored and rebuilt if the input file's size or modification time changes.
+    - DPG, RDP, YXZ, and XYZ input files may be compressed with gzip (.gz), Zstandard (.zst), or xz (.xz).  They're
+      decompressed on a background thread (see decompress.c) into a sliding window that the reader parses in place so
+      nothing is written to disk.  Compressed files are always read by one thread.
+    - An input file of "-" reads YXZ points from standard input and "fifo:" followed by a path reads a named pipe (the
+      rest of the name picks the file type and compression, e.g. fifo:/tmp/pipe.xyz.gz).  Pipes go through the same
+      background reader thread as compressed files so nothing ever seeks.  When any input is a pipe progress is reported
+      in points instead of percent.
+    - Added a native LAS 1.2 through 1.4 reader (.las files, see las.c).  Point records are read in blocks and decoded
+      in one pass using the header scale and offset (Z is negated to be positive down).  Withheld points are always
+      dropped and the new [las_classes] parameter (e.g. [las_classes] = 2,29,40) limits the classifications used.  The
+      header bounds are used to skip files outside of the area and big files are split into READER_LAS_POINTS point
+      ranges.  LAS files must be in geographic coordinates and LAZ isn't supported.
+    - Added chrtr2 point files (.ch2p, see pointfile.h).  With [point_file] = name in the parameter file every point
+      that the readers deliver is also saved, sorted along a Morton curve, in 65536 point chunks of scaled integer X/Y
+      and float Z columns with a bounding box index.  A point file can then be used as an input file on later runs,
+      where it's memory mapped, only the chunks that touch the area are decoded, and big files are split into
+      READER_POINT_CHUNKS chunk ranges.
+    - Added [prefetch_files] (default 8, 0 turns it off).  A prefetch thread opens the next [prefetch_files] input files
+      that haven't been handed to a decoder yet and asks the kernel (posix_fadvise WILLNEED) to start reading the first
+      64MB of each so slow or network disks aren't idle between files.  The input file list now grows as needed instead
+      of being limited to 4000 files.
+    - Added the [prebin] option.  When set, the decoder threads bin their own points into per thread grid cell tiles
+      (chart plus search radius).  The tiles are merged in parallel and only one point per occupied cell (the mean, or
+      the original point nearest the node when force_original_value is set) is loaded into MISP.  This is faster and
+      smaller but it is not the same grid.  MISP sees one point per cell with no count or weight, so a cell with a
+      thousand soundings counts the same as a cell with one, and the distance weighting of the individual points within
+      the search radius is lost.  The node values will differ from a run without [prebin].
+    - Added the [thin_factor] and [thin_method] options.  When [thin_factor] is set, the points are binned on the
+      decoder threads into sub-cells thin_factor times finer than the grid, and only one point per occupied sub-cell is
+      loaded into MISP.  [thin_method] picks that point: 0 for the shoalest sounding (the default), 1 for the mean, or 2
+      for the median, which takes the shoaler middle value when the count is even.
+    - Added the [sort_directory] and [sort_memory_mb] options.  When [sort_directory] is set, the points are sorted into
+      Morton (Z-order) order of their grid cells before they're loaded into MISP, so the loads sweep the grid instead of
+      jumping around in file order.  No more than [sort_memory_mb] megabytes of points (default 1024) are held at a
+      time.  The rest go to sorted run files in sort_directory, which are merged afterwards.  The Morton key and radix
+      sort that the point file writer used are now shared in morton.c.
+    - When nibbling, the MISP output is now kept in memory in 64 x 64 cell tiles (surface.c) instead of being written,
+      read back, and patched a cell at a time.  The nibble is done as a separable dilation of the real cells (a row pass
+      then a column pass) whose cost doesn't depend on the nibble distance, and each row is put together from the tiles
+      and written once after nibbling.
+    - When there are fewer input files than decoder threads, reader_plan is asked to split each file into enough ranges
+      to keep every thread busy. PFM bands shrink from 128 rows down to no fewer than 16 rows when that gives more
+      bands, so a single PFM input is read by all of the threads.
+    - HOF and TOF ranges likewise shrink from 1M shots down to no fewer than 64K shots when there are fewer files than
+      decoder threads, so a single lidar file is read by all of the threads.
+    - GSF files smaller than 128MB are no longer opened with the GSF index when the files are planned, so an index is no
+      longer built (and written next to the file) just to count pings in a file too small to split. The reader's library
+      lock is now one lock per library (GSF, PFM, LLZ), so building a GSF index no longer holds up the PFM and LLZ
+      readers.
+    - When [point_file] is set, the readers no longer cull GSF pings, PFM bins, point file chunks, or whole files to the
+      chart area, and files aren't skipped by their summaries. The point file therefore holds all of the input data and
+      can be used to grid a different area later.
+    - The point file writer no longer keeps every point in memory until the end. It uses the same spill sort as
+      [sort_directory] (sorted run files plus a merge), so it holds no more than [sort_memory_mb] megabytes of points.
+      The run files go in [sort_directory], or next to the point file if that isn't set. The chunks are written as the
+      merge hands back the points, and the points are now in Morton order over the whole globe instead of over the
+      file's bounds.
+    - Piped input (standard input and fifo: names) no longer waits for the 8MB decompression window or a 4MB
+      decompressed chunk to fill. decompress_read returns whatever has arrived (like read(2)), compressed pipes hand out
+      what they've decompressed before waiting for more input (including at the end of each gzip member), the window is
+      parsed as soon as it holds a complete record or line, and reader_read returns the points it has instead of waiting
+      for the rest of the block.
+    - [gsf_fast_geolocation] now defaults to 1, so GSF beams are positioned with the tangent plane expansion (one set of
+      trig calls per ping) unless the parameter file sets it to 0. Each ping's outermost beam is still checked against
+      newgp, and the whole ping falls back to newgp if they differ by more than 1 cm or the ping is poleward of 85
+      degrees.
+    - [prebin] and [thin_factor] binning no longer keeps a full copy of every tile on every decoder thread until the end
+      of the input. Each thread folds its tiles into one shared set when it finishes a file (or part of one), or when it
+      holds 256 tiles (48MB), so peak memory is the shared cells (48 bytes per cell, 64 x 64 cells at a time where
+      there's data) plus at most 48MB per decoder thread. [thin_method] 2 (median) still has to keep every Z (8 bytes
+      per point) until the end; that is now limited to [sort_memory_mb] megabytes and chrtr2 stops with a message saying
+      so if it's exceeded.
+    - On Windows, compressed input files and standard input are now read in binary mode. Text mode turned CR/LF pairs
+      into LF and stopped at the first 0x1A byte, silently corrupting or truncating .gz, .zst, and .xz files and binary
+      DPG/RDP streams read through - or fifo:.
+    - The [sort_directory] spill sort no longer opens every run file at once. At most 256 runs (fewer with a small
+      [sort_memory_mb], so each still gets a 96KB read buffer) are merged at a time, and groups are merged into bigger
+      runs until the rest fit in one pass, so a big input no longer runs out of file descriptors (or past
+      [sort_memory_mb]) after everything has been read. Note that with [point_file] set the point file writer's sort
+      holds its own [sort_memory_mb] at the same time as the [sort_directory] sort, so together they can use twice that.
+    - The [prebin]/[thin_factor] cell and tile indices are now 64 bit, so a large chart with a big [thin_factor] no
+      longer overflows them and writes outside the tile table. A negative [thin_factor] now turns thinning off, and one
+      bigger than 16 is cut back to 16. Both print a message.
+
 */